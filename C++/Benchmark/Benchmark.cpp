@@ -0,0 +1,452 @@
+//Benchmarks of the C++ library: time and heap allocations per operation.
+//
+//Build it together with the sources, for example:
+//  g++ -std=c++17 -O2 -I../Source Benchmark.cpp ../Source/Equation.cpp ../Source/Fraction.cpp ../Source/Parser/fparser.cc
+//      ../Source/Parser/fparser_jit.cc ../Source/Parser/fparser_archive.cc ../Source/Parser/fparser_interval.cc
+//      ../Source/Parser/fpoptimizer.cc -o benchmark -lpthread
+//
+//Usage: benchmark [filter] [--min-time=seconds]
+//Only the benchmarks whose name contains the filter are run; each one is repeated until it has run for at least min-time
+//(0.2 seconds by default), so that the results are stable enough to be compared between two versions of the library.
+
+#include "Equation.h"
+#include "Fraction.h"
+#include "Parser/fparser_archive.hh"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace NA_Equation;
+using namespace NA_Fraction;
+
+// --------- ALLOCATION COUNTER --------- //
+
+//GCC sees the pointers of the inlined operator new go to free()
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+namespace {
+	std::atomic<long long> allocations{ 0 };
+}
+
+void* operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (auto p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+	std::free(p);
+}
+
+// --------- HARNESS --------- //
+
+namespace {
+
+	double minTime = 0.2;
+	const char* filter = "";
+
+	//Keeps the compiler from removing the computations whose result is not used
+	volatile double sink;
+
+	void consume(double x) {
+		sink = x;
+	}
+
+	void consume(const std::complex<double>& x) {
+		sink = x.real() + x.imag();
+	}
+
+	//A benchmark whose results can be verified reports the wrong ones here, and the program returns 1
+	bool failed = false;
+
+	void check(bool condition, const std::string& name) {
+		if (!condition) {
+			std::printf("%s: wrong result\n", name.c_str());
+			failed = true;
+		}
+	}
+
+	template<typename Operation>
+	void benchmark(const std::string& name, const Operation& operation) {
+		if (name.find(filter) == std::string::npos)
+			return;
+
+		using clock = std::chrono::steady_clock;
+		operation();
+
+		//the number of iterations grows until the run is long enough
+		long long iterations = 1;
+		double seconds = 0;
+		long long allocated = 0;
+		while (true) {
+			const auto before = allocations.load(std::memory_order_relaxed);
+			const auto t1 = clock::now();
+			for (long long i = 0; i < iterations; ++i)
+				operation();
+			const auto t2 = clock::now();
+
+			allocated = allocations.load(std::memory_order_relaxed) - before;
+			seconds = std::chrono::duration<double>(t2 - t1).count();
+			if (seconds >= minTime || iterations >= (1LL << 40))
+				break;
+
+			const auto target = (seconds > 0) ? 1.4 * minTime / seconds * iterations : 10.0 * iterations;
+			iterations = std::max(iterations + 1, std::min(static_cast<long long>(target), 10 * iterations));
+		}
+
+		std::printf("%-44s %14.1f %14lld %12.2f\n", name.c_str(), seconds * 1.0e9 / iterations, iterations,
+			static_cast<double>(allocated) / iterations);
+	}
+
+	const std::vector<std::string> expressions = {
+		"x^3-2*x+1",
+		"exp(x)-2.1*x^2",
+		"sin(x)*cos(x)+log(x+1)/sqrt(x^2+1)",
+		"x^5-3*x^4+2*x^3-x^2+4*x-7+x*sin(2*x)*exp(-x^2/3)"
+	};
+
+	// --------- PARSER --------- //
+
+	void parserBenchmarks() {
+		for (std::size_t i = 0; i < expressions.size(); ++i) {
+			const auto& expression = expressions[i];
+			const auto suffix = "/" + std::to_string(i);
+
+			benchmark("Parse" + suffix, [&] {
+				FunctionParser parser;
+				consume(parser.Parse(expression, "x"));
+			});
+
+			benchmark("ParseAndOptimize" + suffix, [&] {
+				FunctionParser parser;
+				parser.Parse(expression, "x");
+				parser.Optimize();
+			});
+
+			FunctionParser plain;
+			plain.Parse(expression, "x");
+			auto x = 0.5;
+			benchmark("Eval" + suffix, [&] {
+				x += 1.0e-9;
+				consume(plain.Eval(&x));
+			});
+
+			FunctionParser optimized;
+			optimized.Parse(expression, "x");
+			optimized.Optimize();
+			benchmark("EvalOptimized" + suffix, [&] {
+				x += 1.0e-9;
+				consume(optimized.Eval(&x));
+			});
+		}
+
+		//a library of 5000 constants: the lookups and the copy of the parser shouldn't depend much on its size
+		FunctionParser library;
+		for (auto i = 0; i < 5000; ++i)
+			library.AddConstant("k" + std::to_string(i), i);
+		benchmark("Parse/5000 constants", [&] {
+			consume(library.Parse("k12*x+k4000*sin(x)+k99/k2345^2+k1+k2+k3+k4+k5+k6", "x"));
+		});
+		benchmark("FunctionParser copy/5000 constants", [&] {
+			FunctionParser copy(library);
+			consume(copy.AddConstant("k0", 1));
+		});
+
+		//16 inline variables, each fetched twice by the next one: the derivative names them instead of copying them
+		//into every use, so its size grows with the number of variables, not with 2^16
+		std::string chain = "a:=x*x+1; v0:=a*a+x;";
+		for (auto i = 1; i < 16; ++i)
+			chain += " v" + std::to_string(i) + ":=v" + std::to_string(i - 1) + "*v" + std::to_string(i - 1) + "+x;";
+		chain += " v15";
+		FunctionParser chained;
+		chained.Parse(chain, "x");
+		FunctionParser derivative;
+		const auto differentiated = chained.Differentiate(derivative, 0);
+		FunctionParser::EvalContext evalContext;
+		auto x = -0.5, expected = 0.0;
+		chained.EvalWithDerivative(evalContext, &x, 0, expected);
+		check(differentiated && std::fabs(derivative.Eval(&x) - expected) <= 1.0e-12 * std::fabs(expected),
+			"Differentiate/16 chained variables");
+		benchmark("Differentiate/16 chained variables", [&] {
+			FunctionParser result;
+			consume(chained.Differentiate(result, 0));
+		});
+	}
+
+	//the optimized bytecode saved to a file in the working directory and loaded back
+	void archiveBenchmarks() {
+		const std::string fileName = "benchmark.fpa";
+		FunctionParserArchive<double> writer;
+		for (const auto& expression : expressions) {
+			FunctionParser parser;
+			parser.Parse(expression, "x");
+			parser.Optimize();
+			writer.Add(expression, parser);
+		}
+		if (!writer.Save(fileName)) {
+			std::printf("Cannot write %s\n", fileName.c_str());
+			return;
+		}
+
+		benchmark("FunctionParserArchive::Open", [&] {
+			FunctionParserArchive<double> archive;
+			consume(archive.Open(fileName));
+		});
+
+		FunctionParserArchive<double> archive;
+		archive.Open(fileName);
+		for (unsigned i = 0; i < archive.Size(); ++i) {
+			benchmark("FunctionParserArchive::Load/" + std::to_string(i), [&] {
+				FunctionParser parser;
+				consume(archive.Load(i, parser));
+			});
+		}
+
+		archive.Close();
+		std::remove(fileName.c_str());
+	}
+
+	// --------- EQUATION --------- //
+
+	void equationBenchmarks() {
+		//a root in 1.36662340703786, inside the sign change in [1, 2]
+		Equation test{ "exp(x)-2.1*x^2" };
+
+		const std::vector<std::pair<std::string, std::vector<double>>> runs = {
+			{ "Newton", { 1.3, 1.0e-10, 50 } },
+			{ "NewtonWithMultiplicity", { 1.3, 1.0e-10, 50, 1 } },
+			{ "Secant", { 1, 2, 1.0e-10, 50 } },
+			{ "Brent", { 1, 2, 1.0e-10, 50 } },
+			{ "Illinois", { 1, 2, 1.0e-10, 50 } },
+			{ "AndersonBjorck", { 1, 2, 1.0e-10, 50 } },
+			{ "ITP", { 1, 2, 1.0e-10, 50 } },
+			{ "Ridders", { 1, 2, 1.0e-10, 50 } }
+		};
+
+		benchmark("Equation/Peephole", [&] {
+			Equation equation{ "exp(x)-2.1*x^2", Optimization::Peephole };
+			consume(equation.evaluateOn(1.0));
+		});
+
+		benchmark("Equation/Full", [&] {
+			Equation equation{ "exp(x)-2.1*x^2", Optimization::Full };
+			consume(equation.evaluateOn(1.0));
+		});
+
+		benchmark("Equation/copy", [&] {
+			Equation equation{ test };
+			consume(equation.evaluateOn(1.0));
+		});
+
+		//a table of 5000 constants shared by the equations instead of copied into each one
+		FunctionParser library;
+		for (auto i = 0; i < 5000; ++i)
+			library.AddConstant("k" + std::to_string(i), i);
+		const SymbolTable symbols{ library };
+		benchmark("Equation/SymbolTable/5000 constants", [&] {
+			Equation equation{ "k12*x-k4000", symbols, Optimization::Peephole };
+			consume(equation.evaluateOn(1.0));
+		});
+
+		//a parser switched to another table calls the function of the new one
+		FunctionParser increment, scale, parser;
+		increment.Parse("x+1", "x");
+		scale.Parse("x*10", "x");
+		FunctionParser first, second;
+		first.AddFunction("f", increment);
+		second.AddFunction("f", scale);
+		parser.UseSymbolTable(SymbolTable{ first });
+		parser.Parse("f(x)", "x");
+		parser.UseSymbolTable(SymbolTable{ second });
+		parser.Parse("f(x)", "x");
+		const double one = 1;
+		check(parser.Eval(&one) == 10, "UseSymbolTable");
+
+		for (std::size_t i = 0; i < runs.size(); ++i) {
+			const auto algorithm = static_cast<Algorithm>(i);
+			const auto& inputList = runs[i].second;
+			benchmark("solveEquation/" + runs[i].first, [&] {
+				consume(std::get<0>(test.solveEquation(algorithm, inputList)));
+			});
+		}
+
+		SolverParameters parameters;
+		parameters.guess = 1.3;
+		parameters.maxIter = 50;
+		benchmark("solve<Newton>", [&] {
+			consume(test.solve<Algorithm::Newton>(parameters).root);
+		});
+
+		parameters.guess = 1;
+		parameters.secondGuess = 2;
+		benchmark("solve<Brent>", [&] {
+			consume(test.solve<Algorithm::Brent>(parameters).root);
+		});
+
+		//the positive root of x^2 - c for 1000 values of c between 1 and 100
+		Equation quadratic{ "x^2-c", "x; c" };
+		std::vector<double> values(1000);
+		std::vector<SolveResult> results(values.size());
+		for (std::size_t i = 0; i < values.size(); ++i)
+			values[i] = 1 + 99.0 * i / values.size();
+		parameters.guess = 1;
+		benchmark("sweep/Newton/1000", [&] {
+			quadratic.sweep(Algorithm::Newton, parameters, values.data(), values.size(), results.data());
+			consume(results.back().root);
+		});
+
+		benchmark("continuation/Tangent/1000", [&] {
+			consume(static_cast<double>(quadratic.continuation(Predictor::Tangent, parameters, values.data(), values.size(), results.data())));
+		});
+
+		//the 31 roots of sin(1/x) in [0.01, 1], each one proven by the interval Newton method
+		Equation oscillating{ "sin(1/x)" };
+		benchmark("isolateRoots/sin(1/x)", [&] {
+			consume(static_cast<double>(oscillating.isolateRoots(0.01, 1).size()));
+		});
+	}
+
+	// --------- POLYNOMIALS --------- //
+
+	void polynomialBenchmarks() {
+		const Quadratic quadratic{ 2, -3, 1 };
+		benchmark("Quadratic::getSolutions", [&] {
+			consume(quadratic.getSolutions()[0]);
+		});
+
+		const Cubic cubic{ 5, -3, 1, 2 };
+		benchmark("Cubic::getSolutions", [&] {
+			consume(cubic.getSolutions()[0]);
+		});
+
+		const Quartic quartic{ 24, -50, 35, -10, 1 };
+		benchmark("Quartic::getSolutions", [&] {
+			consume(quartic.getSolutions()[0]);
+		});
+
+		//1000 quartics in a batch, the even ones squares of quadratics: their resolvent cubic has a double root. Every root must
+		//have a backward error at rounding level
+		const std::size_t batch = 1000;
+		std::vector<double> a(batch), b(batch), c(batch), d(batch), e(batch, 1.0);
+		std::vector<std::complex<double>> quarticRoots(4 * batch);
+		unsigned seed = 271828;
+		const auto next = [&seed] {
+			seed = seed * 1664525u + 1013904223u;
+			return seed / 429496729.6 - 5;
+		};
+		for (std::size_t i = 0; i < batch; ++i) {
+			//(x^2 + 1)^2, (x^2 + 3)^2 and (x^2 + 2x + 5)^2 first
+			const auto p = i < 6 ? (i == 4 ? 2.0 : 0.0) : next(), q = i < 6 ? (i == 2 ? 3.0 : i == 4 ? 5.0 : 1.0) : next();
+			const auto r = i % 2 == 0 ? p : next(), t = i % 2 == 0 ? q : next();
+			a[i] = q * t;
+			b[i] = p * t + q * r;
+			c[i] = q + t + p * r;
+			d[i] = p + r;
+		}
+		solveQuartics(a.data(), b.data(), c.data(), d.data(), e.data(), batch, quarticRoots.data());
+		auto accurate = true;
+		for (std::size_t i = 0; i < 4 * batch; ++i) {
+			const auto& z = quarticRoots[i];
+			const auto k = i / 4;
+			const auto modulus = std::abs(z);
+			const auto value = (((z + d[k]) * z + c[k]) * z + b[k]) * z + a[k];
+			const auto bound = (((modulus + std::fabs(d[k])) * modulus + std::fabs(c[k])) * modulus + std::fabs(b[k])) * modulus + std::fabs(a[k]);
+			accurate = accurate && std::abs(value) <= 1.0e-13 * bound;
+		}
+		check(accurate, "solveQuartics/1000");
+		benchmark("solveQuartics/1000", [&] {
+			solveQuartics(a.data(), b.data(), c.data(), d.data(), e.data(), batch, quarticRoots.data());
+			consume(quarticRoots[0]);
+		});
+
+		const Polynomial polynomial{ { 1, -3, 2, -1, 4, -7 } };
+		auto x = 0.5;
+		benchmark("Polynomial::evaluateOn", [&] {
+			x += 1.0e-9;
+			consume(polynomial.evaluateOn(x));
+		});
+
+		std::vector<double> points(1024), values(1024);
+		for (std::size_t i = 0; i < points.size(); ++i)
+			points[i] = -2 + 4.0 * i / points.size();
+		benchmark("Polynomial::evaluateOn/1024", [&] {
+			polynomial.evaluateOn(points.data(), values.data(), points.size());
+			consume(values[0]);
+		});
+
+		//degree 600, the coefficients from a fixed pseudo-random sequence in [-1, 1)
+		std::vector<double> coefficients(601);
+		unsigned state = 12345;
+		for (auto& coefficient : coefficients) {
+			state = state * 1664525u + 1013904223u;
+			coefficient = state / 2147483648.0 - 1;
+		}
+		const PolyEquation highDegree{ coefficients, PolyAlgorithm::Aberth };
+		benchmark("PolyEquation::getSolutions/Aberth/600", [&] {
+			consume(highDegree.getSolutions()[0]);
+		});
+	}
+
+	// --------- FRACTION --------- //
+
+	void fractionBenchmarks() {
+		auto x = 0.375;
+		benchmark("Fraction(double)", [&] {
+			x += 1.0e-3;
+			if (x > 100)
+				x = 0.375;
+			consume(Fraction{ x }.getDenominator());
+		});
+
+		const std::string text = "355/113";
+		benchmark("Fraction(string)", [&] {
+			consume(Fraction{ text }.getNumerator());
+		});
+	}
+
+}
+
+int main(int argc, char* argv[]) {
+	for (auto i = 1; i < argc; ++i) {
+		if (std::strncmp(argv[i], "--min-time=", 11) == 0)
+			minTime = std::atof(argv[i] + 11);
+		else
+			filter = argv[i];
+	}
+
+	std::printf("%-44s %14s %14s %12s\n", "Benchmark", "ns/op", "Iterations", "Allocs/op");
+	std::printf("%s\n", std::string(87, '-').c_str());
+
+	parserBenchmarks();
+	archiveBenchmarks();
+	equationBenchmarks();
+	polynomialBenchmarks();
+	fractionBenchmarks();
+
+	return failed ? 1 : 0;
+}
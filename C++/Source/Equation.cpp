@@ -2,16 +2,130 @@
 #include <cmath>
 #include <chrono>
 #include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <limits>
+
+//Polynomial::evaluateOn() on many points uses the same switch as the batch evaluation of the parser
+#if !defined(FP_NO_SIMD_EVAL)
+# if defined(__x86_64__) || defined(_M_X64)
+#  define NA_SIMD_X86
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#   include <intrin.h>
+#  endif
+# elif defined(__aarch64__) || defined(_M_ARM64)
+#  define NA_SIMD_NEON
+#  include <arm_neon.h>
+# endif
+#endif
 
 namespace NA_Equation {
 
 	// --------- POLYNOMIAL CLASS --------- //
 
+	namespace {
+
+		//Horner's method on the coefficients, highest degree first: one multiplication and one addition per coefficient
+		inline double hornerAt(const double* poly, std::size_t size, double x) {
+			auto result = poly[0];
+			for (std::size_t i = 1; i < size; ++i)
+				result = result * x + poly[i];
+			return result;
+		}
+
+		using HornerKernel = void(*)(const double*, std::size_t, const double*, double*, std::size_t);
+
+//Horner's method on many points at once: every lane of a vector holds a point and four vectors are evaluated side by side,
+//so that the multiplications and the additions of the four chains overlap. The leftover points are computed with hornerAt(),
+//and since fused multiply-adds are not used every instruction set gives the results of the scalar evaluation
+#define NA_HORNER_KERNEL(Name, Attributes, Width, Vec, Load, Store, Set1, Add, Mul) \
+		Attributes void Name(const double* poly, std::size_t size, const double* xs, double* out, std::size_t n) { \
+			std::size_t i = 0; \
+			for (; i + 4 * (Width) <= n; i += 4 * (Width)) { \
+				const Vec x0 = Load(xs + i), x1 = Load(xs + i + (Width)), x2 = Load(xs + i + 2 * (Width)), x3 = Load(xs + i + 3 * (Width)); \
+				Vec r0 = Set1(poly[0]), r1 = r0, r2 = r0, r3 = r0; \
+				for (std::size_t k = 1; k < size; ++k) { \
+					const Vec c = Set1(poly[k]); \
+					r0 = Add(Mul(r0, x0), c); \
+					r1 = Add(Mul(r1, x1), c); \
+					r2 = Add(Mul(r2, x2), c); \
+					r3 = Add(Mul(r3, x3), c); \
+				} \
+				Store(out + i, r0); \
+				Store(out + i + (Width), r1); \
+				Store(out + i + 2 * (Width), r2); \
+				Store(out + i + 3 * (Width), r3); \
+			} \
+			for (; i + (Width) <= n; i += (Width)) { \
+				const Vec x0 = Load(xs + i); \
+				Vec r0 = Set1(poly[0]); \
+				for (std::size_t k = 1; k < size; ++k) \
+					r0 = Add(Mul(r0, x0), Set1(poly[k])); \
+				Store(out + i, r0); \
+			} \
+			for (; i < n; ++i) \
+				out[i] = hornerAt(poly, size, xs[i]); \
+		}
+
+#ifdef NA_SIMD_X86
+#if defined(__GNUC__) || defined(__clang__)
+# define NA_SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+# define NA_SIMD_TARGET(isa)
+#endif
+
+		NA_HORNER_KERNEL(hornerSse2, , 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd, _mm_add_pd, _mm_mul_pd)
+		NA_HORNER_KERNEL(hornerAvx2, NA_SIMD_TARGET("avx2"), 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, _mm256_add_pd, _mm256_mul_pd)
+
+		//no AVX-512 kernel: it implies FMA, and the compilers would fuse the multiplications and the additions
+		HornerKernel selectHornerKernel() {
+#ifdef _MSC_VER
+			int info[4];
+			__cpuid(info, 0);
+			const auto maxLeaf = info[0];
+			__cpuid(info, 1);
+			//the OS must save the AVX registers on context switch
+			const auto osxsave = (info[2] & (1 << 27)) != 0;
+			const auto avx = (info[2] & (1 << 28)) != 0;
+			if (maxLeaf >= 7 && avx && osxsave && (_xgetbv(0) & 0x6) == 0x6) {
+				__cpuidex(info, 7, 0);
+				if (info[1] & (1 << 5))
+					return hornerAvx2;
+			}
+#else
+			__builtin_cpu_init();
+			if (__builtin_cpu_supports("avx2"))
+				return hornerAvx2;
+#endif
+			return hornerSse2;
+		}
+#undef NA_SIMD_TARGET
+#elif defined(NA_SIMD_NEON)
+		NA_HORNER_KERNEL(hornerNeon, , 2, float64x2_t, vld1q_f64, vst1q_f64, vdupq_n_f64, vaddq_f64, vmulq_f64)
+
+		HornerKernel selectHornerKernel() {
+			//Advanced SIMD is mandatory on AArch64
+			return hornerNeon;
+		}
+#else
+		void hornerScalar(const double* poly, std::size_t size, const double* xs, double* out, std::size_t n) {
+			for (std::size_t i = 0; i < n; ++i)
+				out[i] = hornerAt(poly, size, xs[i]);
+		}
+
+		HornerKernel selectHornerKernel() {
+			return hornerScalar;
+		}
+#endif
+#undef NA_HORNER_KERNEL
+
+	}
+
 	double Polynomial::horner(double x) const {
-		int power = 0;
-		double result = 0;
-		std::for_each(poly.rbegin(), poly.rend(), [&](int val) { result += val * pow(x, power); ++power; });
-		return result;
+		return hornerAt(poly.data(), poly.size(), x);
 	}
 
 	void Polynomial::negate() {
@@ -31,8 +145,9 @@ namespace NA_Equation {
 			std::vector<double> temp{};
 			temp.reserve(poly.size() - 1);
 
-			for (auto i = 0; i < poly.size() - 1; ++i)
-				temp.push_back(poly[i + 1] * (i + 1));
+			//the coefficients are stored from the highest degree: a_i x^(n - i) becomes (n - i) a_i x^(n - i - 1)
+			for (auto i = 0; i < polyDegree; ++i)
+				temp.push_back(poly[i] * (polyDegree - i));
 			return Polynomial(temp);
 		}
 
@@ -42,6 +157,11 @@ namespace NA_Equation {
 		return this->horner(x);
 	}
 
+	void Polynomial::evaluateOn(const double* xs, double* out, std::size_t n) const {
+		static const auto kernel = selectHornerKernel();
+		kernel(poly.data(), poly.size(), xs, out, n);
+	}
+
 	double Polynomial::operator[](int x) {
 		return poly[x];
 	}
@@ -52,9 +172,146 @@ namespace NA_Equation {
 
 	// --------- EQUATION CLASS --------- //
 
+	namespace {
+
+		std::string trim(const std::string& text) {
+			const auto begin = text.find_first_not_of(" \t");
+			if (begin == std::string::npos)
+				return "";
+			return text.substr(begin, text.find_last_not_of(" \t") - begin + 1);
+		}
+
+		//"x; a, b, c" is given to the parser as "x,a,b,c", and the names of the parameters are appended to parameterNames
+		std::string declare(const std::string& variables, std::vector<std::string>& parameterNames) {
+			const auto invalid = "The variables must be the unknown followed by the parameters, for example \"x; a, b, c\"";
+
+			const auto separator = variables.find(';');
+			auto declaration = trim(variables.substr(0, separator));
+			if (declaration.empty() || declaration.find(',') != std::string::npos)
+				throw std::runtime_error(invalid);
+
+			if (separator != std::string::npos && !trim(variables.substr(separator + 1)).empty()) {
+				const auto list = variables.substr(separator + 1);
+				std::size_t begin = 0;
+				while (true) {
+					const auto end = list.find(',', begin);
+					const auto name = trim(list.substr(begin, end - begin));
+					if (name.empty())
+						throw std::runtime_error(invalid);
+
+					parameterNames.push_back(name);
+					declaration += "," + name;
+					if (end == std::string::npos)
+						break;
+					begin = end + 1;
+				}
+			}
+			return declaration;
+		}
+
+	}
+
+	Equation::Equation(const std::string& expression, const std::string& variables, Optimization level) : x(0), time(0), expr(expression) {
+		FunctionParserCache<double>::global().Parse(parser, this->expr, declare(variables, parameterNames), false, level == Optimization::Full);
+		context.vars.assign(parameterNames.size() + 1, 0.0);
+	}
+
+	Equation::Equation(const std::string& expression, const std::string& variables, const SymbolTable& symbols, Optimization level) : x(0), time(0), expr(expression) {
+		parser.UseSymbolTable(symbols);
+		parser.Parse(this->expr, declare(variables, parameterNames));
+		if (level == Optimization::Full)
+			parser.Optimize();
+		context.vars.assign(parameterNames.size() + 1, 0.0);
+	}
+
+	std::size_t Equation::parameterCount() const {
+		return parameterNames.size();
+	}
+
+	std::size_t Equation::parameterSlot(const std::string& name) const {
+		const auto found = std::find(parameterNames.begin(), parameterNames.end(), name);
+		if (found == parameterNames.end())
+			throw std::runtime_error("Unknown parameter: " + name);
+
+		return static_cast<std::size_t>(found - parameterNames.begin());
+	}
+
+	const std::string& Equation::parameterName(std::size_t slot) const {
+		return parameterNames.at(slot);
+	}
+
+	double* Equation::parameters() {
+		return context.vars.data() + 1;
+	}
+
+	const double* Equation::parameters() const {
+		return context.vars.data() + 1;
+	}
+
+	void Equation::setParameter(const std::string& name, double value) {
+		parameters()[parameterSlot(name)] = value;
+	}
+
+	bool Equation::compileNative() {
+		native = std::make_shared<FunctionParserJIT>(parser);
+		if (native->GetCompiledFunction() == nullptr)
+			native.reset();
+
+		if (native && derivativeParser) {
+			nativeDerivative = std::make_shared<FunctionParserJIT>(*derivativeParser);
+			if (nativeDerivative->GetCompiledFunction() == nullptr)
+				nativeDerivative.reset();
+		}
+
+		return native != nullptr;
+	}
+
+	bool Equation::compileDerivative() {
+		auto result = std::make_shared<FunctionParser>();
+		if (!parser.Differentiate(*result, 0))
+			return false;
+
+		derivativeParser = result;
+		if (native) {
+			nativeDerivative = std::make_shared<FunctionParserJIT>(*derivativeParser);
+			if (nativeDerivative->GetCompiledFunction() == nullptr)
+				nativeDerivative.reset();
+		}
+
+		return true;
+	}
+
 	double Equation::evaluateOn(double x) {
-		double var[1] = { x };
-		return parser.Eval(var);
+		return evaluateOn(x, context);
+	}
+
+	double Equation::evaluateOn(double x, Context& context) const {
+		context.vars[0] = x;
+		//native code exists only when it has been compiled, and then it is reentrant
+		return native ? native->GetCompiledFunction()(context.vars.data()) : parser.Eval(context.eval, context.vars.data());
+	}
+
+	void Equation::evaluateOn(const double* xs, double* out, std::size_t n) {
+		if (native) {
+			for (std::size_t i = 0; i < n; ++i)
+				out[i] = evaluateOn(xs[i], context);
+		}
+		else if (parameterNames.empty())
+			parser.EvalBatch(context.eval, xs, n, out);
+		else {
+			//the batch evaluation takes all the variables of a point in a row
+			const auto width = context.vars.size();
+			const auto block = std::min<std::size_t>(n, 256);
+			std::vector<double> rows(block * width);
+			for (std::size_t i = 0; i < n; i += block) {
+				const auto m = std::min(block, n - i);
+				for (std::size_t k = 0; k < m; ++k) {
+					std::copy(context.vars.begin() + 1, context.vars.end(), rows.begin() + k * width + 1);
+					rows[k * width] = xs[i + k];
+				}
+				parser.EvalBatch(context.eval, rows.data(), m, out + i);
+			}
+		}
 	}
 
 	double Equation::elapsedMilliseconds() const {
@@ -62,11 +319,147 @@ namespace NA_Equation {
 	}
 
 	double Equation::evaluateDerivative(double x) {
-		double var[1] = { x + h };
-		double res = parser.Eval(var);
+		return evaluateDerivative(x, context);
+	}
+
+	double Equation::evaluateDerivative(double x, Context& context) const {
+		auto derivative = 0.0;
+		evaluateWithDerivative(x, derivative, context);
+		return derivative;
+	}
+
+	double Equation::evaluateWithDerivative(double x, double& derivative, Context& context) const {
+		context.vars[0] = x;
+		const auto vars = context.vars.data();
+
+		//the native f'(x) is faster than the dual numbers, but the interpreted one is not: the symbolic derivative is often
+		//much longer than f
+		if (nativeDerivative) {
+			derivative = nativeDerivative->GetCompiledFunction()(vars);
+			return evaluateOn(x, context);
+		}
+
+		//f(x) and f'(x) with dual numbers, in a single pass over the bytecode; f(x) itself comes from the native code, if any
+		const auto fx = parser.EvalWithDerivative(context.eval, vars, 0, derivative);
+		return native ? native->GetCompiledFunction()(vars) : fx;
+	}
+
+	double Equation::evaluateOn(double x, Context& context, SolveStats* stats) const {
+		if (stats)
+			++stats->evaluations;
+		return evaluateOn(x, context);
+	}
+
+	double Equation::evaluateWithDerivative(double x, double& derivative, Context& context, SolveStats* stats) const {
+		if (stats) {
+			++stats->evaluations;
+			++stats->derivativeEvaluations;
+		}
+		return evaluateWithDerivative(x, derivative, context);
+	}
+
+	namespace {
+
+		void checkBracketInput(const std::vector<double>& inputList) {
+			if (inputList.size() != 4)
+				throw std::runtime_error("The inputList array must contain 4 parameters: the lower bound, the upper bound, the tolerance and the max. number of iterations");
+		}
+
+		//The list of solveEquation() as the parameters of the algorithm
+		SolverParameters toParameters(Algorithm algorithm, const std::vector<double>& inputList) {
+			auto parameters = SolverParameters{};
+
+			switch (algorithm) {
+			case Algorithm::Newton:
+				if (inputList.size() != 3)
+					throw std::runtime_error("The inputList array must contain 3 parameters: the initial guess, the tolerance and the max. number of iterations");
+				parameters.guess = inputList[0];
+				parameters.tolerance = inputList[1];
+				parameters.maxIter = static_cast<int>(inputList[2]);
+				break;
+			case Algorithm::NewtonWithMultiplicity:
+				if (inputList.size() != 4)
+					throw std::runtime_error("The inputList array must contain 4 parameters: the initial guess, the tolerance, the max. number of iterations and the multiplicity");
+				parameters.guess = inputList[0];
+				parameters.tolerance = inputList[1];
+				parameters.maxIter = static_cast<int>(inputList[2]);
+				parameters.multiplicity = static_cast<int>(inputList[3]);
+				break;
+			case Algorithm::Secant:
+				if (inputList.size() != 4)
+					throw std::runtime_error("The Points array must contain 4 parameters: the first guess, the second guess, the tolerance and the max. number of iterations.");
+				parameters.guess = inputList[0];
+				parameters.secondGuess = inputList[1];
+				parameters.tolerance = inputList[2];
+				parameters.maxIter = static_cast<int>(inputList[3]);
+				break;
+			default:
+				checkBracketInput(inputList);
+				parameters.guess = inputList[0];
+				parameters.secondGuess = inputList[1];
+				parameters.tolerance = inputList[2];
+				parameters.maxIter = static_cast<int>(inputList[3]);
+			}
+
+			return parameters;
+		}
+
+	}
 
-		double var2[1] = { x };
-		return (res - parser.Eval(var2)) / h;
+	SolveResult Equation::dispatch(Algorithm algorithm, const SolverParameters& parameters, const IterationSink* trace, SolveStats* stats,
+		Context& context) const {
+		switch (algorithm) {
+		case Algorithm::Newton: return run<Algorithm::Newton>(parameters, trace, stats, context);
+		case Algorithm::NewtonWithMultiplicity: return run<Algorithm::NewtonWithMultiplicity>(parameters, trace, stats, context);
+		case Algorithm::Secant: return run<Algorithm::Secant>(parameters, trace, stats, context);
+		case Algorithm::Brent: return run<Algorithm::Brent>(parameters, trace, stats, context);
+		case Algorithm::Illinois: return run<Algorithm::Illinois>(parameters, trace, stats, context);
+		case Algorithm::AndersonBjorck: return run<Algorithm::AndersonBjorck>(parameters, trace, stats, context);
+		case Algorithm::ITP: return run<Algorithm::ITP>(parameters, trace, stats, context);
+		case Algorithm::Ridders: return run<Algorithm::Ridders>(parameters, trace, stats, context);
+		}
+
+		throw std::runtime_error("Unknown algorithm");
+	}
+
+	Result Equation::collect(Algorithm algorithm, const SolverParameters& parameters, bool guessList, Context& context) const {
+		std::vector<double> guessesList = {};
+		auto push = [&](double x) { guessesList.push_back(x); };
+		const IterationSink sink{ push };
+
+		if (guessList)
+			guessesList.reserve(parameters.maxIter + 1);
+
+		auto result = dispatch(algorithm, parameters, guessList ? &sink : nullptr, nullptr, context);
+		guessesList.shrink_to_fit();
+
+		return Result{ result.root, result.residual, guessesList };
+	}
+
+	SolveResult Equation::profile(Algorithm algorithm, const SolverParameters& parameters, const IterationSink* trace, SolveStats& stats,
+		Context& context) const {
+
+		//the last step is the distance between the last two estimates
+		stats = SolveStats{};
+		auto previous = parameters.guess, last = parameters.guess;
+		auto record = [&](double x) {
+			previous = last;
+			last = x;
+			if (trace)
+				(*trace)(x);
+		};
+		const IterationSink sink{ record };
+
+		auto t1 = std::chrono::steady_clock::now();
+		auto result = dispatch(algorithm, parameters, &sink, &stats, context);
+		auto t2 = std::chrono::steady_clock::now();
+
+		stats.nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(t2 - t1).count();
+		stats.iterations = result.iterations;
+		stats.lastStep = fabs(last - previous);
+		stats.residual = result.residual;
+		stats.status = result.status;
+		return result;
 	}
 
 	Result Equation::solveEquation(double guess) {
@@ -75,151 +468,958 @@ namespace NA_Equation {
 
 	Result Equation::solveEquation(Algorithm algorithm, const std::vector<double>& inputList, bool guessList) {
 		auto t1 = std::chrono::high_resolution_clock::now();
-		auto result = algorithmList.at(algorithm)(inputList, guessList);
+		auto result = collect(algorithm, toParameters(algorithm, inputList), guessList, context);
 		auto t2 = std::chrono::high_resolution_clock::now();
 
-		this->time = std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count();
+		this->time = std::chrono::duration<double, std::milli>(t2 - t1).count();
 		return result;
 	}
 
-	void Equation::init() {
-		//Newton method
-		algorithmList[Algorithm::Newton] = [&](const std::vector<double>& inputList, bool guessList) {
+	namespace {
 
-			if (inputList.size() != 3)
-				throw std::runtime_error("The inputList array must contain 3 parameters: the initial guess, the tolerance and the max. number of iterations");
+		bool isBracketing(Algorithm algorithm) {
+			return algorithm == Algorithm::Brent || algorithm == Algorithm::Illinois || algorithm == Algorithm::AndersonBjorck ||
+				algorithm == Algorithm::ITP || algorithm == Algorithm::Ridders;
+		}
 
-			auto x0 = inputList[0];
-			auto toll = inputList[1];
-			auto diff = inputList[1] + 1;
-			auto n = 0;
-			auto n_max = static_cast<int>(inputList[2]);
-			std::vector<double> guessesList = {};
+		//Number of initial guesses consumed by one run of the algorithm
+		std::size_t startPointsOf(Algorithm algorithm) {
+			return (algorithm == Algorithm::Secant || isBracketing(algorithm)) ? 2 : 1;
+		}
+
+		void checkSignChange(double fa, double fb) {
+			if (!((fa <= 0 && fb >= 0) || (fa >= 0 && fb <= 0)))
+				throw std::runtime_error("The function must have opposite signs at the bounds of the interval");
+		}
 
-			if (guessList) {
-				guessesList.reserve(n_max);
-				guessesList.push_back(x0);
+		//Runs task(i, worker) for every i in [0, count) on 'workers' threads. Each thread starts
+		//from its own contiguous share of the indices and, once it's done, steals from the others
+		template<typename Task>
+		void parallelFor(std::size_t count, unsigned workers, const Task& task) {
+			struct Queue {
+				std::mutex lock;
+				std::deque<std::size_t> tasks;
+			};
+
+			std::vector<Queue> queues(workers);
+			for (std::size_t i = 0; i < count; ++i)
+				queues[i * workers / count].tasks.push_back(i);
+
+			auto work = [&](unsigned self) {
+				while (true) {
+					auto found = false;
+					std::size_t index = 0;
+
+					{
+						std::lock_guard<std::mutex> guard(queues[self].lock);
+						if (!queues[self].tasks.empty()) {
+							index = queues[self].tasks.back();
+							queues[self].tasks.pop_back();
+							found = true;
+						}
+					}
+
+					for (unsigned k = 1; !found && k < workers; ++k) {
+						auto& victim = queues[(self + k) % workers];
+						std::lock_guard<std::mutex> guard(victim.lock);
+						if (!victim.tasks.empty()) {
+							index = victim.tasks.front();
+							victim.tasks.pop_front();
+							found = true;
+						}
+					}
+
+					//no task is added once started, so empty queues mean that we're done
+					if (!found)
+						return;
+
+					task(index, self);
+				}
+			};
+
+			std::vector<std::thread> threads;
+			threads.reserve(workers - 1);
+			for (unsigned i = 1; i < workers; ++i)
+				threads.emplace_back(work, i);
+
+			work(0);
+			for (auto& t : threads)
+				t.join();
+		}
+
+	}
+
+	std::vector<Result> Equation::solveParallel(Algorithm algorithm, const std::vector<double>& guesses, const std::vector<double>& parameters,
+		double rootTolerance, double residualTolerance, bool guessList) {
+
+		auto t1 = std::chrono::high_resolution_clock::now();
+		const auto arity = startPointsOf(algorithm);
+		const auto runs = (guesses.size() >= arity) ? guesses.size() - arity + 1 : 0;
+
+		//the start points are replaced by the ones of each run
+		std::vector<double> inputList(arity, 0.0);
+		inputList.insert(inputList.end(), parameters.begin(), parameters.end());
+		const auto common = toParameters(algorithm, inputList);
+
+		auto workers = std::max(1u, std::thread::hardware_concurrency());
+		if (runs < workers)
+			workers = static_cast<unsigned>(std::max<std::size_t>(runs, 1));
+
+		std::vector<Context> contexts(workers, context);
+		std::vector<Result> found(runs);
+		std::vector<char> attempted(runs, 0), converged(runs, 0);
+		std::vector<std::exception_ptr> errors(runs);
+
+		parallelFor(runs, workers, [&](std::size_t i, unsigned worker) {
+			auto start = common;
+			start.guess = guesses[i];
+			if (arity == 2)
+				start.secondGuess = guesses[i + 1];
+
+			try {
+				//an interval without a sign change is not an error, it just doesn't contain a root
+				if (isBracketing(algorithm)) {
+					auto fa = evaluateOn(start.guess, contexts[worker]);
+					auto fb = evaluateOn(start.secondGuess, contexts[worker]);
+					if (!((fa <= 0 && fb >= 0) || (fa >= 0 && fb <= 0)))
+						return;
+				}
+
+				attempted[i] = 1;
+				auto result = collect(algorithm, start, guessList, contexts[worker]);
+				auto x0 = std::get<0>(result);
+				auto residual = evaluateOn(x0, contexts[worker]);
+
+				if (std::isfinite(x0) && fabs(residual) <= residualTolerance) {
+					std::get<1>(result) = residual;
+					found[i] = std::move(result);
+					converged[i] = 1;
+				}
+			}
+			catch (...) {
+				errors[i] = std::current_exception();
+			}
+		});
+
+		//an error on every start point means wrong parameters rather than a bad guess
+		std::exception_ptr firstError = nullptr;
+		auto failures = std::size_t{ 0 }, attempts = std::size_t{ 0 };
+		for (std::size_t i = 0; i < runs; ++i) {
+			attempts += attempted[i];
+			if (errors[i]) {
+				++failures;
+				if (!firstError)
+					firstError = errors[i];
 			}
+		}
 
-			while ((diff >= toll) && (n < n_max)) {
-				auto der = this->evaluateDerivative(x0);
-				if (der == 0)
-					throw std::runtime_error("Found a f'(x) = 0");
+		if (attempts > 0 && failures == attempts)
+			std::rethrow_exception(firstError);
 
-				double var[1]{ x0 };
-				diff = -parser.Eval(var) / der;
-				x0 = x0 + diff;
+		std::vector<Result> roots;
+		for (std::size_t i = 0; i < runs; ++i)
+			if (converged[i])
+				roots.push_back(std::move(found[i]));
 
-				if (guessList)
-					guessesList.push_back(x0);
+		std::sort(roots.begin(), roots.end(), [](const Result& a, const Result& b) { return std::get<0>(a) < std::get<0>(b); });
 
-				diff = fabs(diff);
-				++n;
+		//roots closer than rootTolerance are the same root: keep the one with the lowest residual
+		std::vector<Result> distinct;
+		for (auto& root : roots) {
+			if (!distinct.empty() && std::get<0>(root) - std::get<0>(distinct.back()) <= rootTolerance) {
+				if (fabs(std::get<1>(root)) < fabs(std::get<1>(distinct.back())))
+					distinct.back() = std::move(root);
 			}
+			else
+				distinct.push_back(std::move(root));
+		}
 
-			double var[1]{ x0 };
-			auto residual = parser.Eval(var);
-			if (guessList)
-				guessesList.shrink_to_fit();
+		auto t2 = std::chrono::high_resolution_clock::now();
+		this->time = std::chrono::duration<double, std::milli>(t2 - t1).count();
 
-			return Result{ x0, residual, guessesList };
-		};
+		return distinct;
+	}
 
-		//Newton method
-		algorithmList[Algorithm::NewtonWithMultiplicity] = [&](const std::vector<double>& inputList, bool guessList) {
+	std::vector<Result> Equation::solveParallel(Algorithm algorithm, double from, double to, std::size_t points, const std::vector<double>& parameters,
+		double rootTolerance, double residualTolerance, bool guessList) {
 
-			if (inputList.size() != 4)
-				throw std::runtime_error("The inputList array must contain 4 parameters: the initial guess, the tolerance, the max. number of iterations and the multiplicity");
+		if (points < 2)
+			throw std::runtime_error("The range must be split in at least 2 points");
 
-			auto x0 = inputList[0];
-			auto toll = inputList[1];
-			auto diff = inputList[1] + 1;
-			auto n = 0;
-			auto n_max = static_cast<int>(inputList[2]);
-			auto r = static_cast<int>(inputList[3]);
+		std::vector<double> guesses(points);
+		for (std::size_t i = 0; i < points; ++i)
+			guesses[i] = from + (to - from) * i / (points - 1);
 
-			std::vector<double> guessesList = {};
+		return solveParallel(algorithm, guesses, parameters, rootTolerance, residualTolerance, guessList);
+	}
 
-			if (guessList) {
-				guessesList.reserve(n_max);
-				guessesList.push_back(x0);
+	namespace {
+
+		//Where to start a solve of a sweep, given the root of the previous one and the step from the root before it. Newton
+		//starts from the root predicted by the step, the secant method from the last root and the prediction; the bracketing
+		//methods need a sign change, so the bracket around the prediction is widened until f changes sign and the interval
+		//of the parameters is used when it doesn't (the bracket never leaves it)
+		template<typename Function>
+		SolverParameters warmStart(const Function& function, Algorithm algorithm, const SolverParameters& parameters, double root, double step) {
+			auto start = parameters;
+			const auto predicted = root + step;
+
+			if (!isBracketing(algorithm)) {
+				start.guess = (algorithm == Algorithm::Secant) ? root : predicted;
+				start.secondGuess = (step != 0) ? predicted : root + (parameters.secondGuess - parameters.guess);
+				return start;
 			}
 
-			while ((diff >= toll) && (n < n_max)) {
-				auto der = this->evaluateDerivative(x0);
-				if (der == 0)
-					throw std::runtime_error("Found a f'(x) = 0");
+			const auto low = std::min(parameters.guess, parameters.secondGuess);
+			const auto high = std::max(parameters.guess, parameters.secondGuess);
+			auto width = (step != 0) ? 2 * fabs(step) : (high - low) / 64;
+
+			for (auto k = 0; k < 4; ++k, width *= 4) {
+				const auto a = std::max(low, predicted - width);
+				const auto b = std::min(high, predicted + width);
+				if (a == low && b == high)
+					break;
+
+				const auto fa = function(a), fb = function(b);
+				if ((fa <= 0 && fb >= 0) || (fa >= 0 && fb <= 0)) {
+					start.guess = a;
+					start.secondGuess = b;
+					return start;
+				}
+			}
 
-				double var[1]{ x0 };
-				diff = -r * (parser.Eval(var) / der);
-				x0 = x0 + diff;
+			return parameters;
+		}
 
-				if (guessList)
-					guessesList.push_back(x0);
+	}
 
-				diff = fabs(diff);
-				++n;
+	void Equation::sweep(Algorithm algorithm, const SolverParameters& parameters, const double* values, std::size_t count, SolveResult* results) {
+		auto t1 = std::chrono::high_resolution_clock::now();
+		const auto width = parameterNames.size();
+
+		//every chunk starts cold, so they are long enough for the warm starts to pay off and enough to keep the cores busy
+		auto workers = std::max(1u, std::thread::hardware_concurrency());
+		const auto chunkSize = std::max<std::size_t>(64, (count + 4 * workers - 1) / (4 * workers));
+		const auto chunks = (count + chunkSize - 1) / chunkSize;
+		if (chunks < workers)
+			workers = static_cast<unsigned>(std::max<std::size_t>(chunks, 1));
+
+		std::vector<Context> contexts(workers, context);
+		std::vector<std::exception_ptr> errors(chunks);
+
+		parallelFor(chunks, workers, [&](std::size_t chunk, unsigned worker) {
+			auto& local = contexts[worker];
+			auto function = [&](double x) { return evaluateOn(x, local); };
+			const auto end = std::min(count, (chunk + 1) * chunkSize);
+
+			//the roots found so far in a row, the last one and the step from the one before
+			auto found = 0;
+			auto last = 0.0, step = 0.0;
+
+			try {
+				for (auto i = chunk * chunkSize; i < end; ++i) {
+					std::copy(values + i * width, values + (i + 1) * width, local.vars.begin() + 1);
+
+					auto result = SolveResult{};
+					auto solved = false;
+					if (found > 0) {
+						try {
+							result = dispatch(algorithm, warmStart(function, algorithm, parameters, last, step), nullptr, nullptr, local);
+							solved = result.status == SolveStatus::Converged && std::isfinite(result.root);
+						}
+						catch (const std::runtime_error&) {
+							//the start of the parameters may work anyway
+						}
+					}
+
+					if (!solved)
+						result = dispatch(algorithm, parameters, nullptr, nullptr, local);
+
+					results[i] = result;
+					if (result.status == SolveStatus::Converged && std::isfinite(result.root)) {
+						step = (found > 0) ? result.root - last : 0;
+						last = result.root;
+						++found;
+					}
+					else
+						found = 0;
+				}
+			}
+			catch (...) {
+				errors[chunk] = std::current_exception();
 			}
+		});
+
+		auto t2 = std::chrono::high_resolution_clock::now();
+		this->time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+		//a solve that raises an exception stops its chunk; the first one is raised again here
+		for (const auto& error : errors)
+			if (error)
+				std::rethrow_exception(error);
+	}
+
+	std::size_t Equation::continuation(Predictor predictor, const SolverParameters& parameters, const double* values, std::size_t count,
+		SolveResult* results) {
+
+		auto t1 = std::chrono::high_resolution_clock::now();
+		const auto width = parameterNames.size();
+		const auto nan = std::numeric_limits<double>::quiet_NaN();
+		std::fill(results, results + count, SolveResult{ nan, nan, 0, SolveStatus::MaxIterations });
 
-			double var[1]{ x0 };
-			auto residual = parser.Eval(var);
-			if (guessList)
-				guessesList.shrink_to_fit();
+		//a correction in up to quickCorrection iterations doubles the step, one that takes more than slowCorrection iterations
+		//is rejected; a step below minStep (a fraction of the segment between two vectors) means the root can't be followed
+		const auto quickCorrection = 3, slowCorrection = 6;
+		const auto minStep = 1.0 / (1 << 20);
 
-			return Result{ x0, residual, guessesList };
+		//the path moves the parameters of a copy of the context, so the values given with setParameter() are kept
+		auto local = context;
+
+		auto accepted = [](const SolveResult& result) {
+			return result.status == SolveStatus::Converged && std::isfinite(result.root);
 		};
 
-		//Secant method
-		algorithmList[Algorithm::Secant] = [&](const std::vector<double>& inputList, bool guessList) {
+		auto correct = [&](double guess, SolveResult& result) {
+			auto start = parameters;
+			start.guess = guess;
+			try {
+				result = run<Algorithm::Newton>(start, nullptr, nullptr, local);
+				return accepted(result);
+			}
+			catch (const std::runtime_error&) {
+				//f'(x) = 0
+				return false;
+			}
+		};
 
-			if (inputList.size() != 4)
-				throw std::runtime_error("The Points array must contain 4 parameters: the first guess, the second guess, the tolerance and the max. number of iterations.");
-
-			auto n = 1;
-			auto xold = inputList[0];
-			auto x0 = inputList[1];
-			auto toll = inputList[2];
-			auto n_max = static_cast<int>(inputList[3]);
-			std::vector<double> guessesList = {};
-
-			if (guessList) {
-				guessesList.reserve(n_max);
-				guessesList.push_back(x0);
-			}
-
-			double var[1]{ xold };
-			auto fold = parser.Eval(var);
-			double var2[1]{ x0 };
-			auto fnew = parser.Eval(var2);
-			auto diff = toll + 1;
-
-			while ((diff >= toll) && (n < n_max)) {
-				auto den = fnew - fold;
-				if (den == 0)
-					throw std::runtime_error("Denominator is zero");
-
-				diff = -(fnew*(x0 - xold)) / den;
-				xold = x0;
-				fold = fnew;
-				x0 = x0 + diff;
-				diff = abs(diff);
+		auto followed = std::size_t{ 0 };
+		auto current = SolveResult{};
+		if (count > 0) {
+			std::copy(values, values + width, local.vars.begin() + 1);
+			if (correct(parameters.guess, current)) {
+				results[0] = current;
+				followed = 1;
+			}
+		}
+
+		//the last root, the one before and the distance between them along the path (1 from a vector to the next)
+		auto x = current.root, previous = current.root, lastStep = 0.0;
+		auto step = 1.0;
+		std::vector<double> direction(width + 1, 0.0);
+
+		while (followed > 0 && followed < count) {
+			const auto from = values + (followed - 1) * width;
+			const auto to = values + followed * width;
+			for (std::size_t j = 0; j < width; ++j)
+				direction[j + 1] = to[j] - from[j];
+
+			//t is the position on the segment from 'from' to 'to'
+			auto t = 0.0;
+			auto iterations = 0;
+			while (t < 1 && step >= minStep) {
+				const auto last = step >= 1 - t;
+				const auto next = last ? 1.0 : t + step;
+				const auto h = next - t;
+
+				auto predicted = x;
+				if (predictor == Predictor::Tangent) {
+					//the parameters are still the ones of t, where x is a root
+					auto dfdx = 0.0, dfdp = 0.0;
+					local.vars[0] = x;
+					parser.EvalWithDerivative(local.eval, local.vars.data(), 0, dfdx);
+					parser.EvalWithDirectionalDerivative(local.eval, local.vars.data(), direction.data(), dfdp);
+					if (dfdx != 0 && std::isfinite(dfdp / dfdx))
+						predicted = x - h * dfdp / dfdx;
+				}
+				else if (lastStep > 0)
+					predicted = x + (x - previous) * h / lastStep;
+
+				for (std::size_t j = 0; j < width; ++j)
+					local.vars[j + 1] = from[j] + next * (to[j] - from[j]);
+
+				//the root shouldn't move from the prediction more than the prediction moved from the last root, or it may have
+				//jumped to another branch
+				auto result = SolveResult{};
+				const auto converged = correct(predicted, result);
+				iterations += result.iterations;
+				const auto tolerance = 10 * (parameters.tolerance + std::numeric_limits<double>::epsilon() * fabs(x));
+				const auto jumped = fabs(result.root - predicted) > std::max(fabs(predicted - x), tolerance) &&
+					(predictor == Predictor::Tangent || lastStep > 0);
+
+				if (converged && result.iterations <= slowCorrection && !jumped) {
+					previous = x;
+					x = result.root;
+					lastStep = h;
+					t = next;
+					current = result;
+					if (result.iterations <= quickCorrection)
+						step = std::min(2 * step, 1.0);
+				}
+				else {
+					step /= 2;
+					//back to the parameters of t
+					for (std::size_t j = 0; j < width; ++j)
+						local.vars[j + 1] = from[j] + t * (to[j] - from[j]);
+				}
+			}
+
+			if (t < 1)
+				break;
+
+			current.iterations = iterations;
+			results[followed++] = current;
+		}
+
+		auto t2 = std::chrono::high_resolution_clock::now();
+		this->time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+		return followed;
+	}
+
+	void Equation::compileIntervals() {
+		if (intervalFunction)
+			return;
+
+		auto function = std::make_shared<FunctionParserInterval>(parser);
+		if (!function->IsSupported())
+			throw std::runtime_error("The expression cannot be evaluated on intervals (comparisons, logical operators, if() and mod)");
+
+		//without bounds of f' the roots are isolated by bisection alone
+		auto derivative = FunctionParser{};
+		if (derivativeParser)
+			derivative = *derivativeParser;
+		if (derivativeParser || parser.Differentiate(derivative, 0)) {
+			auto slope = std::make_shared<FunctionParserInterval>(derivative);
+			if (slope->IsSupported())
+				intervalDerivative = slope;
+		}
+		intervalFunction = function;
+	}
+
+	Interval Equation::evaluateOn(const Interval& x) {
+		compileIntervals();
+		std::vector<Interval> vars(context.vars.size()), stack(intervalFunction->GetStackSize());
+		vars[0] = x;
+		for (std::size_t j = 1; j < vars.size(); ++j)
+			vars[j] = Interval{ context.vars[j], context.vars[j] };
+		return intervalFunction->Eval(vars.data(), stack.data());
+	}
+
+	std::vector<RootInterval> Equation::isolateRoots(double from, double to, double resolution) {
+		if (!std::isfinite(from) || !std::isfinite(to) || from > to)
+			throw std::runtime_error("The domain must be a finite interval");
+
+		auto t1 = std::chrono::high_resolution_clock::now();
+		compileIntervals();
+
+		//the parameters are fixed, only vars[0] changes
+		const auto derivativeStack = intervalDerivative ? intervalDerivative->GetStackSize() : 0u;
+		std::vector<Interval> vars(context.vars.size());
+		std::vector<Interval> stack(std::max(intervalFunction->GetStackSize(), derivativeStack));
+		for (std::size_t j = 1; j < vars.size(); ++j)
+			vars[j] = Interval{ context.vars[j], context.vars[j] };
+
+		auto bounds = [&](const FunctionParserInterval& function, const Interval& x, bool* continuous = nullptr) {
+			vars[0] = x;
+			return function.Eval(vars.data(), stack.data(), continuous);
+		};
+		//false for the empty intervals as well
+		auto containsZero = [](const Interval& y) { return y.lower <= 0 && y.upper >= 0; };
+		auto width = [](const Interval& x) { return x.upper - x.lower; };
+
+		//after maxIntervals subintervals (a function with infinitely many roots, like sin(1/x) near 0) the ones left are
+		//returned as Possible, however wide
+		const auto maxIntervals = std::size_t{ 1 } << 20;
+		const auto splitRatio = 0.4990234375;
+		auto examined = std::size_t{ 0 };
+
+		std::vector<RootInterval> found;
+		std::vector<Interval> pending{ Interval{ from, to } };
+		while (!pending.empty()) {
+			auto box = pending.back();
+			pending.pop_back();
+			if (++examined > maxIntervals) {
+				found.push_back(RootInterval{ box.lower, box.upper, RootStatus::Possible });
+				continue;
+			}
+			auto continuous = false;
+			if (!containsZero(bounds(*intervalFunction, box, &continuous)))
+				continue;
+
+			//where f is continuous and the bounds of f' exclude zero there's at most one root, and it's inside
+			//N(X) = m - f(m) / f'(X): the box is replaced by its intersection with N(X) while that halves it at least, and
+			//N(X) inside the box proves the root
+			auto proven = false;
+			auto slope = intervalDerivative && continuous ? bounds(*intervalDerivative, box) : Interval{ 0, 0 };
+			while (!containsZero(slope) && !FunctionParserInterval::IsEmpty(slope) && width(box) > resolution) {
+				const auto m = Interval{ box.lower + width(box) / 2, box.lower + width(box) / 2 };
+				const auto newton = FunctionParserInterval::Sub(m, FunctionParserInterval::Div(bounds(*intervalFunction, m), slope));
+				if (newton.lower >= box.lower && newton.upper <= box.upper)
+					proven = true;
+
+				const auto next = FunctionParserInterval::Intersect(box, newton);
+				const auto contracted = width(next) <= width(box) / 2;
+				const auto changed = next.lower != box.lower || next.upper != box.upper;
+				box = next;
+				if (FunctionParserInterval::IsEmpty(box) || !(contracted || (proven && changed)))
+					break;
+				slope = bounds(*intervalDerivative, box);
+			}
+
+			if (FunctionParserInterval::IsEmpty(box))
+				continue;
+			if (proven) {
+				found.push_back(RootInterval{ box.lower, box.upper, RootStatus::Unique });
+				continue;
+			}
+
+			//a little off the center, so that roots in round numbers like 0 aren't on the border of two boxes
+			const auto middle = box.lower + width(box) * splitRatio;
+			if (width(box) > resolution && middle > box.lower && middle < box.upper) {
+				//the left part is examined first
+				pending.push_back(Interval{ middle, box.upper });
+				pending.push_back(Interval{ box.lower, middle });
+			}
+			else if (containsZero(bounds(*intervalFunction, box)))
+				found.push_back(RootInterval{ box.lower, box.upper, RootStatus::Possible });
+		}
+
+		//adjacent Possible intervals are the same cluster of roots
+		std::sort(found.begin(), found.end(), [](const RootInterval& a, const RootInterval& b) { return a.lower < b.lower; });
+		std::vector<RootInterval> roots;
+		for (const auto& root : found) {
+			if (!roots.empty() && root.status == RootStatus::Possible && roots.back().status == RootStatus::Possible &&
+				root.lower <= roots.back().upper)
+				roots.back().upper = std::max(roots.back().upper, root.upper);
+			else
+				roots.push_back(root);
+		}
+
+		auto t2 = std::chrono::high_resolution_clock::now();
+		this->time = std::chrono::duration<double, std::milli>(t2 - t1).count();
+		return roots;
+	}
+
+	//Newton method
+	template<>
+	SolveResult Equation::run<Algorithm::Newton>(const SolverParameters& parameters, const IterationSink* trace, SolveStats* stats, Context& context) const {
+		auto x0 = parameters.guess;
+		auto toll = parameters.tolerance;
+		auto diff = parameters.tolerance + 1;
+		auto n = 0;
+		auto n_max = parameters.maxIter;
+
+		if (trace)
+			(*trace)(x0);
+
+		while ((diff >= toll) && (n < n_max)) {
+			auto der = 0.0;
+			auto fx = evaluateWithDerivative(x0, der, context, stats);
+			if (der == 0)
+				throw std::runtime_error("Found a f'(x) = 0");
+
+			diff = -fx / der;
+			x0 = x0 + diff;
+
+			if (trace)
+				(*trace)(x0);
+
+			diff = fabs(diff);
+			++n;
+		}
+
+		auto residual = evaluateOn(x0, context, stats);
+		return SolveResult{ x0, residual, n, (diff < toll) ? SolveStatus::Converged : SolveStatus::MaxIterations };
+	}
+
+	//Newton method
+	template<>
+	SolveResult Equation::run<Algorithm::NewtonWithMultiplicity>(const SolverParameters& parameters, const IterationSink* trace, SolveStats* stats, Context& context) const {
+		auto x0 = parameters.guess;
+		auto toll = parameters.tolerance;
+		auto diff = parameters.tolerance + 1;
+		auto n = 0;
+		auto n_max = parameters.maxIter;
+		auto r = parameters.multiplicity;
+
+		if (trace)
+			(*trace)(x0);
+
+		while ((diff >= toll) && (n < n_max)) {
+			auto der = 0.0;
+			auto fx = evaluateWithDerivative(x0, der, context, stats);
+			if (der == 0)
+				throw std::runtime_error("Found a f'(x) = 0");
+
+			diff = -r * (fx / der);
+			x0 = x0 + diff;
+
+			if (trace)
+				(*trace)(x0);
+
+			diff = fabs(diff);
+			++n;
+		}
+
+		auto residual = evaluateOn(x0, context, stats);
+		return SolveResult{ x0, residual, n, (diff < toll) ? SolveStatus::Converged : SolveStatus::MaxIterations };
+	}
+
+	//Secant method
+	template<>
+	SolveResult Equation::run<Algorithm::Secant>(const SolverParameters& parameters, const IterationSink* trace, SolveStats* stats, Context& context) const {
+		auto n = 1;
+		auto xold = parameters.guess;
+		auto x0 = parameters.secondGuess;
+		auto toll = parameters.tolerance;
+		auto n_max = parameters.maxIter;
+
+		if (trace)
+			(*trace)(x0);
+
+		auto fold = evaluateOn(xold, context, stats);
+		auto fnew = evaluateOn(x0, context, stats);
+		auto diff = toll + 1;
+
+		while ((diff >= toll) && (n < n_max)) {
+			auto den = fnew - fold;
+			if (den == 0)
+				throw std::runtime_error("Denominator is zero");
+
+			diff = -(fnew*(x0 - xold)) / den;
+			xold = x0;
+			fold = fnew;
+			x0 = x0 + diff;
+			diff = fabs(diff);
+			++n;
+
+			if (trace)
+				(*trace)(x0);
+
+			fnew = evaluateOn(x0, context, stats);
+		}
+
+		//fnew is already f(x0), the root returned
+		return SolveResult{ x0, fnew, n - 1, (diff < toll) ? SolveStatus::Converged : SolveStatus::MaxIterations };
+	}
+
+	//Brent's method
+	template<>
+	SolveResult Equation::run<Algorithm::Brent>(const SolverParameters& parameters, const IterationSink* trace, SolveStats* stats, Context& context) const {
+		auto a = parameters.guess;
+		auto b = parameters.secondGuess;
+		auto toll = parameters.tolerance;
+		auto n = 0;
+		auto n_max = parameters.maxIter;
+
+		auto fa = evaluateOn(a, context, stats);
+		auto fb = evaluateOn(b, context, stats);
+		checkSignChange(fa, fb);
+
+		if (trace)
+			(*trace)(b);
+
+		//c is the other end of the bracket, d the last step and e the one before
+		auto c = a;
+		auto fc = fa;
+		auto d = b - a;
+		auto e = d;
+		auto converged = false;
+
+		while (n < n_max) {
+			if ((fb > 0 && fc > 0) || (fb < 0 && fc < 0)) {
+				c = a;
+				fc = fa;
+				d = e = b - a;
+			}
+
+			//b is always the best estimate
+			if (fabs(fc) < fabs(fb)) {
+				a = b; b = c; c = a;
+				fa = fb; fb = fc; fc = fa;
+			}
+
+			auto tol1 = 2 * std::numeric_limits<double>::epsilon() * fabs(b) + 0.5 * toll;
+			auto xm = 0.5 * (c - b);
+			if (fabs(xm) <= tol1 || fb == 0) {
+				converged = true;
+				break;
+			}
+
+			if (fabs(e) >= tol1 && fabs(fa) > fabs(fb)) {
+				//secant or inverse quadratic interpolation
+				auto s = fb / fa;
+				double p, q;
+
+				if (a == c) {
+					p = 2 * xm * s;
+					q = 1 - s;
+				}
+				else {
+					auto r = fb / fc;
+					q = fa / fc;
+					p = s * (2 * xm * q * (q - r) - (b - a) * (r - 1));
+					q = (q - 1) * (r - 1) * (s - 1);
+				}
+
+				if (p > 0)
+					q = -q;
+				p = fabs(p);
+
+				if (2 * p < std::min(3 * xm * q - fabs(tol1 * q), fabs(e * q))) {
+					e = d;
+					d = p / q;
+				}
+				else {
+					d = xm;
+					e = d;
+				}
+			}
+			else {
+				//bisection
+				d = xm;
+				e = d;
+			}
+
+			a = b;
+			fa = fb;
+			b += (fabs(d) > tol1) ? d : std::copysign(tol1, xm);
+			fb = evaluateOn(b, context, stats);
+			++n;
+
+			if (trace)
+				(*trace)(b);
+		}
+
+		return SolveResult{ b, fb, n, converged ? SolveStatus::Converged : SolveStatus::MaxIterations };
+	}
+
+	namespace {
+
+		//Illinois and Anderson-Bjorck methods (modified regula falsi), they differ only in the scaling of f(a)
+		template<typename Function>
+		SolveResult modifiedRegulaFalsi(const Function& function, bool andersonBjorck, const SolverParameters& parameters, const IterationSink* trace) {
+			auto a = parameters.guess;
+			auto b = parameters.secondGuess;
+			auto toll = parameters.tolerance;
+			auto n = 0;
+			auto n_max = parameters.maxIter;
+
+			auto fa = function(a);
+			auto fb = function(b);
+			checkSignChange(fa, fb);
+
+			if (trace)
+				(*trace)(b);
+
+			//b is the last estimate and [a, b] (or [b, a]) the bracket
+			while ((fabs(b - a) >= toll) && (fb != 0) && (n < n_max)) {
+				auto c = b - fb * (b - a) / (fb - fa);
+				if (c == b)
+					break;
+
+				auto fc = function(c);
+
+				if ((fc > 0) != (fb > 0)) {
+					//the root is between b and c
+					a = b;
+					fa = fb;
+				}
+				else {
+					//b is replaced on the same side twice in a row: scale down f(a)
+					auto m = 0.5;
+					if (andersonBjorck) {
+						m = 1 - fc / fb;
+						if (m <= 0)
+							m = 0.5;
+					}
+					fa *= m;
+				}
+
+				b = c;
+				fb = fc;
 				++n;
 
-				if (guessList)
-					guessesList.push_back(x0);
+				if (trace)
+					(*trace)(b);
+			}
+
+			//the loop stops before n_max only when the bracket is small enough or the estimate can't change anymore
+			const auto converged = n < n_max || fabs(b - a) < toll || fb == 0;
+			return SolveResult{ b, fb, n, converged ? SolveStatus::Converged : SolveStatus::MaxIterations };
+		}
+
+	}
+
+	template<>
+	SolveResult Equation::run<Algorithm::Illinois>(const SolverParameters& parameters, const IterationSink* trace, SolveStats* stats, Context& context) const {
+		return modifiedRegulaFalsi([&](double x) { return evaluateOn(x, context, stats); }, false, parameters, trace);
+	}
+
+	template<>
+	SolveResult Equation::run<Algorithm::AndersonBjorck>(const SolverParameters& parameters, const IterationSink* trace, SolveStats* stats, Context& context) const {
+		return modifiedRegulaFalsi([&](double x) { return evaluateOn(x, context, stats); }, true, parameters, trace);
+	}
+
+	//ITP method (Interpolate, Truncate and Project)
+	template<>
+	SolveResult Equation::run<Algorithm::ITP>(const SolverParameters& parameters, const IterationSink* trace, SolveStats* stats, Context& context) const {
+		auto a = std::min(parameters.guess, parameters.secondGuess);
+		auto b = std::max(parameters.guess, parameters.secondGuess);
+		auto toll = parameters.tolerance;
+		auto n = 0;
+		auto n_max = parameters.maxIter;
+
+		auto fa = evaluateOn(a, context, stats);
+		auto fb = evaluateOn(b, context, stats);
+		checkSignChange(fa, fb);
+
+		if (trace)
+			(*trace)((a + b) / 2);
+
+		//the suggested parameters: k1 = 0.2 / (b - a), k2 = 2 and n0 = 1
+		const auto eps = toll / 2;
+		const auto k1 = 0.2 / (b - a);
+		const auto n_half = std::max(0.0, std::ceil(std::log2((b - a) / (2 * eps))));
+		const auto n_itp = n_half + 1;
+
+		while ((b - a > 2 * eps) && (fa != 0) && (fb != 0) && (n < n_max)) {
+			auto x_half = (a + b) / 2;
+			auto r = eps * std::pow(2.0, n_itp - n) - (b - a) / 2;
+			auto delta = k1 * (b - a) * (b - a);
+
+			//interpolation (regula falsi) and truncation
+			auto x_f = (fb * a - fa * b) / (fb - fa);
+			auto sigma = (x_half > x_f) ? 1.0 : (x_half < x_f ? -1.0 : 0.0);
+			auto x_t = (delta <= fabs(x_half - x_f)) ? x_f + sigma * delta : x_half;
+
+			//projection on the minmax interval
+			auto x_itp = (fabs(x_t - x_half) <= r) ? x_t : x_half - sigma * r;
+
+			//when the truncation is lost in rounding the bracket wouldn't shrink anymore
+			if (x_itp <= a || x_itp >= b)
+				x_itp = x_half;
+			auto f_itp = evaluateOn(x_itp, context, stats);
+
+			if (f_itp == 0) {
+				a = b = x_itp;
+				fa = fb = f_itp;
+			}
+			else if ((f_itp > 0) == (fa > 0)) {
+				a = x_itp;
+				fa = f_itp;
+			}
+			else {
+				b = x_itp;
+				fb = f_itp;
+			}
+			++n;
+
+			if (trace)
+				(*trace)((a + b) / 2);
+		}
+
+		auto x0 = (fa == 0) ? a : ((fb == 0) ? b : (a + b) / 2);
+		auto residual = evaluateOn(x0, context, stats);
+		const auto converged = !(b - a > 2 * eps) || fa == 0 || fb == 0;
+		return SolveResult{ x0, residual, n, converged ? SolveStatus::Converged : SolveStatus::MaxIterations };
+	}
 
-				double var3[1]{ x0 };
-				fnew = parser.Eval(var3);
+	//Ridders' method
+	template<>
+	SolveResult Equation::run<Algorithm::Ridders>(const SolverParameters& parameters, const IterationSink* trace, SolveStats* stats, Context& context) const {
+		auto a = parameters.guess;
+		auto b = parameters.secondGuess;
+		auto toll = parameters.tolerance;
+		auto n = 0;
+		auto n_max = parameters.maxIter;
+
+		auto fa = evaluateOn(a, context, stats);
+		auto fb = evaluateOn(b, context, stats);
+		checkSignChange(fa, fb);
+
+		auto x0 = (fabs(fa) < fabs(fb)) ? a : b;
+		auto fx = (fabs(fa) < fabs(fb)) ? fa : fb;
+
+		if (trace)
+			(*trace)(x0);
+
+		auto converged = false;
+		while ((fx != 0) && (fabs(b - a) >= toll) && (n < n_max)) {
+			auto m = (a + b) / 2;
+			auto fm = evaluateOn(m, context, stats);
+			auto s = std::sqrt(fm * fm - fa * fb);
+			if (s == 0) {
+				converged = true;
+				break;
 			}
 
-			double var3[1]{ xold };
-			auto residual = parser.Eval(var3);
-			if (guessList)
-				guessesList.shrink_to_fit();
+			//exponential interpolation between a, m and b
+			auto x = m + (m - a) * ((fa >= fb) ? 1.0 : -1.0) * fm / s;
+			auto diff = fabs(x - x0);
+			x0 = x;
+			fx = evaluateOn(x0, context, stats);
+			++n;
 
-			return Result{ x0, residual, guessesList };
-		};
+			if (trace)
+				(*trace)(x0);
+
+			if (diff < toll) {
+				converged = true;
+				break;
+			}
+
+			//the smallest bracket among a, m, x and b
+			if ((fm > 0) != (fx > 0)) {
+				a = m; fa = fm;
+				b = x0; fb = fx;
+			}
+			else if ((fa > 0) != (fx > 0)) {
+				b = x0; fb = fx;
+			}
+			else {
+				a = x0; fa = fx;
+			}
+		}
+
+		converged = converged || fx == 0 || fabs(b - a) < toll;
+		return SolveResult{ x0, fx, n, converged ? SolveStatus::Converged : SolveStatus::MaxIterations };
+	}
+
+	void SolveStatsSummary::add(const SolveStats& stats) {
+		++solves;
+		converged += (stats.status == SolveStatus::Converged) ? 1 : 0;
+		nanoseconds += stats.nanoseconds;
+		minNanoseconds = std::min(minNanoseconds, stats.nanoseconds);
+		maxNanoseconds = std::max(maxNanoseconds, stats.nanoseconds);
+		iterations += stats.iterations;
+		evaluations += stats.evaluations;
+		derivativeEvaluations += stats.derivativeEvaluations;
+		maxResidual = std::max(maxResidual, std::fabs(stats.residual));
+	}
+
+	SolveStatsSummary& SolveStatsSummary::operator+=(const SolveStatsSummary& other) {
+		solves += other.solves;
+		converged += other.converged;
+		nanoseconds += other.nanoseconds;
+		minNanoseconds = std::min(minNanoseconds, other.minNanoseconds);
+		maxNanoseconds = std::max(maxNanoseconds, other.maxNanoseconds);
+		iterations += other.iterations;
+		evaluations += other.evaluations;
+		derivativeEvaluations += other.derivativeEvaluations;
+		maxResidual = std::max(maxResidual, other.maxResidual);
+		return *this;
+	}
+
+	double SolveStatsSummary::meanNanoseconds() const {
+		return solves ? static_cast<double>(nanoseconds) / solves : 0.0;
+	}
 
+	double SolveStatsSummary::meanIterations() const {
+		return solves ? static_cast<double>(iterations) / solves : 0.0;
+	}
+
+	double SolveStatsSummary::meanEvaluations() const {
+		return solves ? static_cast<double>(evaluations) / solves : 0.0;
 	}
 
 	const Polynomial& PolyBase::getPoly() const {
@@ -321,7 +1521,6 @@ namespace NA_Equation {
 		auto result = PolyResult{};
 		result.reserve(4);
 
-		auto a = std::complex<double>{ Fa };
 		auto b = std::complex<double>{ Fb / Fa };
 		auto c = std::complex<double>{ Fc / Fa };
 		auto d = std::complex<double>{ Fd / Fa };
@@ -348,17 +1547,800 @@ namespace NA_Equation {
 		return result;
 	}
 
+	// --------- BATCH SOLVERS --------- //
+
+	namespace {
+
+		//Roots of x^2 - 2p x + q: the real root with the larger modulus first and the other one from their product, so that no
+		//cancellation happens; p +- i sqrt(q - p^2) when the discriminant is negative. There are no branches, but GCC vectorizes
+		//the loops that call it only if sqrt() may skip errno and the operations may be assumed not to trap
+		//(-fno-math-errno -fno-trapping-math, which don't change the results)
+		inline void monicQuadratic(double p, double q, double* out) {
+			const auto discriminant = p * p - q;
+			const auto root = std::sqrt(std::fabs(discriminant));
+			const auto larger = p + std::copysign(root, p);
+			const auto smaller = q / (larger != 0 ? larger : 1.0);
+			const auto real = discriminant >= 0;
+			out[0] = real ? larger : p;
+			out[1] = real ? 0.0 : root;
+			out[2] = real ? smaller : p;
+			out[3] = real ? 0.0 : -root;
+		}
+
+		//Real roots of x^3 + a x^2 + b x + c, returns how many (1 or 3, a double root being counted twice)
+		inline int cubicRealRoots(double a, double b, double c, double* roots) {
+			const auto third = a / 3;
+			const auto Q = third * third - b / 3;
+			const auto R = third * third * third - third * b / 2 + c / 2;
+
+			//R^2 - Q^3 is minus the discriminant over 108, whose expansion has no a^6 terms that cancel out
+			const auto discriminant = 18 * a * b * c - 4 * a * a * a * c + a * a * b * b - 4 * b * b * b - 27 * c * c;
+			const auto rounding = 32 * std::numeric_limits<double>::epsilon() *
+				(std::fabs(18 * a * b * c) + std::fabs(4 * a * a * a * c) + a * a * b * b + std::fabs(4 * b * b * b) + 27 * c * c);
+
+			//a double root (within the rounding error of the discriminant), which Cardano's formula would miss: with x = t - a / 3
+			//the cubic is t^3 - 3Q t + 2R, whose simple root is -2R / Q and whose double root is R / Q (a triple root in 0 when
+			//Q = 0)
+			if (std::fabs(discriminant) <= rounding) {
+				roots[0] = (Q != 0 ? -2 * R / Q : 0.0) - third;
+				roots[1] = roots[2] = (Q != 0 ? R / Q : 0.0) - third;
+				return 3;
+			}
+
+			//three real roots: the trigonometric form
+			if (discriminant > 0) {
+				//the angles theta / 3 +- 2 pi / 3 from the addition formulas, theta / 3 being in [0, pi / 3]
+				const auto theta = std::acos(std::max(-1.0, std::min(1.0, R / std::sqrt(Q * Q * Q))));
+				const auto cosine = std::cos(theta / 3), sine = std::sqrt(std::max(1 - cosine * cosine, 0.0));
+				const auto radius = -2 * std::sqrt(Q);
+				roots[0] = radius * cosine - third;
+				roots[1] = radius * (-0.5 * cosine - 0.86602540378443865 * sine) - third;
+				roots[2] = radius * (-0.5 * cosine + 0.86602540378443865 * sine) - third;
+				return 3;
+			}
+
+			//one real root: Cardano's formula with the signs chosen so that nothing cancels
+			const auto A = -std::copysign(std::cbrt(std::fabs(R) + std::sqrt(-discriminant / 108)), R);
+			roots[0] = A + (A != 0 ? Q / A : 0.0) - third;
+			return 1;
+		}
+
+		//Newton steps on a real root of x^3 + a x^2 + b x + c, kept while |p(x)| decreases: Cardano's formula loses the small
+		//root to cancellation when the other two have a large modulus
+		inline double polishCubicRoot(double a, double b, double c, double x) {
+			auto value = ((x + a) * x + b) * x + c;
+			for (auto iteration = 0; iteration < 8 && value != 0; ++iteration) {
+				const auto next = x - value / ((3 * x + 2 * a) * x + b);
+				const auto nextValue = ((next + a) * next + b) * next + c;
+				if (!(std::fabs(nextValue) < std::fabs(value)))
+					break;
+
+				x = next;
+				value = nextValue;
+			}
+			return x;
+		}
+
+		//Newton's method on the factorization x^4 + a x^3 + b x^2 + c x + d = (x^2 + alpha1 x + beta1)(x^2 + alpha2 x + beta2),
+		//as in Orellana and De Michele, "Algorithm 1010": the closed formulas give the factors with large errors when the roots
+		//have very different modules, and a quadratic factor with the wrong sign of the discriminant would leave a complex pair
+		//on the real axis. The iterations go on while the backward error of the factors decreases
+		inline void refineQuarticFactors(double a, double b, double c, double d, double* factors) {
+			const auto backwardError = [&](const double* f) {
+				const auto error = [](double residual, double scale) { return scale != 0 ? std::fabs(residual) / scale : std::fabs(residual); };
+				return error(f[0] + f[2] - a, std::fabs(f[0]) + std::fabs(f[2]) + std::fabs(a)) +
+					error(f[1] + f[3] + f[0] * f[2] - b, std::fabs(f[1]) + std::fabs(f[3]) + std::fabs(f[0] * f[2]) + std::fabs(b)) +
+					error(f[0] * f[3] + f[2] * f[1] - c, std::fabs(f[0] * f[3]) + std::fabs(f[2] * f[1]) + std::fabs(c)) +
+					error(f[1] * f[3] - d, std::fabs(f[1] * f[3]) + std::fabs(d));
+			};
+
+			auto error = backwardError(factors);
+			for (auto iteration = 0; iteration < 8 && error > 64 * std::numeric_limits<double>::epsilon(); ++iteration) {
+				const auto alpha1 = factors[0], beta1 = factors[1], alpha2 = factors[2], beta2 = factors[3];
+
+				//the Jacobian of the four equations in (alpha1, beta1, alpha2, beta2) with the residuals, Gaussian elimination
+				//with partial pivoting
+				double m[4][5] = {
+					{ 1, 0, 1, 0, alpha1 + alpha2 - a },
+					{ alpha2, 1, alpha1, 1, beta1 + beta2 + alpha1 * alpha2 - b },
+					{ beta2, alpha2, beta1, alpha1, alpha1 * beta2 + alpha2 * beta1 - c },
+					{ 0, beta2, 0, beta1, beta1 * beta2 - d }
+				};
+				auto singular = false;
+				for (auto col = 0; col < 4 && !singular; ++col) {
+					auto pivot = col;
+					for (auto row = col + 1; row < 4; ++row)
+						if (std::fabs(m[row][col]) > std::fabs(m[pivot][col]))
+							pivot = row;
+					singular = m[pivot][col] == 0;
+
+					std::swap(m[pivot], m[col]);
+					for (auto row = col + 1; row < 4 && !singular; ++row) {
+						const auto factor = m[row][col] / m[col][col];
+						for (auto k = col; k < 5; ++k)
+							m[row][k] -= factor * m[col][k];
+					}
+				}
+				if (singular)
+					break;
+
+				double next[4];
+				for (auto row = 3; row >= 0; --row) {
+					auto sum = m[row][4];
+					for (auto k = row + 1; k < 4; ++k)
+						sum -= m[row][k] * (factors[k] - next[k]);
+					next[row] = factors[row] - sum / m[row][row];
+				}
+
+				const auto nextError = backwardError(next);
+				if (!(nextError < error))
+					break;
+
+				std::copy(next, next + 4, factors);
+				error = nextError;
+			}
+		}
+
+		//Aberth-Ehrlich iterations on the roots given by the closed formulas, whose rounding errors are large when the roots
+		//have very different modules. A root is left alone as soon as its backward error is at rounding level, which is
+		//usually the case from the start. The corrections are applied after each sweep: conjugate pairs stay conjugate and
+		//real roots stay real
+		template<int Degree>
+		inline void polishMonicRoots(const double* coefficients, double* roots) {
+			const auto epsilon = std::numeric_limits<double>::epsilon();
+			double steps[2 * Degree];
+
+			for (auto iteration = 0; iteration < 50; ++iteration) {
+				auto done = true;
+
+				for (auto k = 0; k < 2 * Degree; k += 2) {
+					steps[k] = steps[k + 1] = 0;
+					const auto re = roots[k], im = roots[k + 1];
+					const auto modulus = std::sqrt(re * re + im * im);
+					auto valueRe = 1.0, valueIm = 0.0, derivativeRe = 0.0, derivativeIm = 0.0, bound = 1.0;
+					for (auto i = 0; i < Degree; ++i) {
+						const auto dRe = derivativeRe * re - derivativeIm * im + valueRe;
+						derivativeIm = derivativeRe * im + derivativeIm * re + valueIm;
+						derivativeRe = dRe;
+						const auto vRe = valueRe * re - valueIm * im + coefficients[i];
+						valueIm = valueRe * im + valueIm * re;
+						valueRe = vRe;
+						bound = bound * modulus + std::fabs(coefficients[i]);
+					}
+					if (valueRe * valueRe + valueIm * valueIm <= 16 * epsilon * epsilon * bound * bound)
+						continue;
+
+					std::complex<double> sum{ 0 };
+					for (auto j = 0; j < 2 * Degree; j += 2)
+						if (j != k)
+							sum += 1.0 / std::complex<double>{ re - roots[j], im - roots[j + 1] };
+
+					//p(z) / (p'(z) - p(z) sum), finite where p'(z) = 0. Only the backward error above accepts a root: when the step
+					//is not defined the root waits for the others to move, and a step at rounding level just ends the iterations
+					const std::complex<double> value{ valueRe, valueIm };
+					const auto step = value / (std::complex<double>{ derivativeRe, derivativeIm } - value * sum);
+					if (!std::isfinite(step.real()) || !std::isfinite(step.imag())) {
+						done = false;
+						continue;
+					}
+
+					steps[k] = step.real();
+					steps[k + 1] = step.imag();
+					if (std::abs(step) > 4 * epsilon * modulus)
+						done = false;
+				}
+
+				if (done)
+					break;
+				for (auto k = 0; k < 2 * Degree; ++k)
+					roots[k] -= steps[k];
+			}
+		}
+
+	}
+
+	void solveQuadratics(const double* a, const double* b, const double* c, std::size_t n, std::complex<double>* roots) {
+		//std::complex<double> has the layout of double[2]
+		auto out = reinterpret_cast<double*>(roots);
+		for (std::size_t i = 0; i < n; ++i) {
+			const auto inverse = 1.0 / c[i];
+			monicQuadratic(-0.5 * b[i] * inverse, a[i] * inverse, out + 4 * i);
+		}
+	}
+
+	void solveCubics(const double* a, const double* b, const double* c, const double* d, std::size_t n, std::complex<double>* roots) {
+		auto out = reinterpret_cast<double*>(roots);
+		for (std::size_t i = 0; i < n; ++i) {
+			const auto inverse = 1.0 / d[i];
+			const auto A = c[i] * inverse, B = b[i] * inverse, C = a[i] * inverse;
+
+			//the real root with the largest modulus, whose relative error is small
+			double real[3];
+			const auto count = cubicRealRoots(A, B, C, real);
+			const auto largest = *std::max_element(real, real + count, [](double x, double y) { return std::fabs(x) < std::fabs(y); });
+			const auto x0 = polishCubicRoot(A, B, C, largest);
+
+			//the other roots are the ones of the quotient x^2 + linear x + constant. Its coefficients are computed from the
+			//highest degree (linear = A + x0, constant = B + x0 linear) up to the largest of the terms |x0|^3, |A| |x0|^2,
+			//|B| |x0| and |C|, and from the constant term (constant = -C / x0, linear = (constant - B) / x0) above it: this is
+			//the composite deflation of the polynomial solvers, no rounding error is amplified
+			const auto modulus = std::fabs(x0);
+			const double terms[] = { modulus * modulus * modulus, std::fabs(A) * modulus * modulus, std::fabs(B) * modulus, std::fabs(C) };
+			const auto split = std::max_element(terms, terms + 4) - terms;
+			const auto constant = (split == 3 || x0 == 0) ? B + x0 * (A + x0) : -C / x0;
+			const auto linear = (split >= 2 || x0 == 0) ? A + x0 : (constant - B) / x0;
+
+			auto root = out + 6 * i;
+			root[0] = x0;
+			root[1] = 0;
+			monicQuadratic(-0.5 * linear, constant, root + 2);
+		}
+	}
+
+	void solveQuartics(const double* a, const double* b, const double* c, const double* d, const double* e, std::size_t n, std::complex<double>* roots) {
+		auto out = reinterpret_cast<double*>(roots);
+		for (std::size_t i = 0; i < n; ++i) {
+			const auto inverse = 1.0 / e[i];
+			const auto A = d[i] * inverse, B = c[i] * inverse, C = b[i] * inverse, D = a[i] * inverse;
+
+			//Ferrari without the shift to the depressed quartic, which loses the small roots when A is large:
+			//x^4 + A x^3 + B x^2 + C x + D = (x^2 + A/2 x + y/2)^2 - (s x + t)^2 with s^2 = A^2/4 - B + y, t^2 = y^2/4 - D and
+			//2 s t = A y / 2 - C, y being a root of the resolvent cubic y^3 - B y^2 + (A C - 4D) y - (A^2 D - 4B D + C^2). The
+			//largest one gives s^2 >= 0 and t^2 >= 0
+			const auto cubicB = A * C - 4 * D, cubicC = -(A * A * D - 4 * B * D + C * C);
+			double resolvent[3];
+			const auto count = cubicRealRoots(-B, cubicB, cubicC, resolvent);
+			const auto y = polishCubicRoot(-B, cubicB, cubicC, *std::max_element(resolvent, resolvent + count));
+
+			//t comes from the product 2 s t or from its own square, whichever of s^2 and t^2 is less affected by cancellation
+			const auto squareS = A * A / 4 - B + y, squareT = y * y / 4 - D;
+			const auto relativeS = std::fabs(squareS) / (A * A / 4 + std::fabs(B) + std::fabs(y));
+			const auto relativeT = std::fabs(squareT) / (y * y / 4 + std::fabs(D));
+			const auto s = std::sqrt(std::max(squareS, 0.0)), product = A * y / 2 - C;
+			const auto t = (relativeS >= relativeT && s != 0) ? product / (2 * s) : std::copysign(std::sqrt(std::max(squareT, 0.0)), product);
+
+			//x^2 + (A/2 - s) x + y/2 - t and x^2 + (A/2 + s) x + y/2 + t; the constant term with the smaller modulus comes from
+			//their product D, without cancellation
+			double factors[] = { A / 2 - s, y / 2 - t, A / 2 + s, y / 2 + t };
+			if (std::fabs(factors[1]) > std::fabs(factors[3]))
+				factors[3] = factors[1] != 0 ? D / factors[1] : factors[3];
+			else
+				factors[1] = factors[3] != 0 ? D / factors[3] : factors[1];
+			refineQuarticFactors(A, B, C, D, factors);
+
+			auto root = out + 8 * i;
+			monicQuadratic(-0.5 * factors[0], factors[1], root);
+			monicQuadratic(-0.5 * factors[2], factors[3], root + 4);
+
+			const double coefficients[] = { A, B, C, D };
+			polishMonicRoots<4>(coefficients, root);
+		}
+	}
+
+	// --------- FIXED POLYNOMIAL --------- //
+
+	//same formulas of the batch solvers, the coefficients being stored from the highest degree
+
+	template<>
+	std::array<std::complex<double>, 1> FixedPolynomial<1>::getSolutions() const {
+		return { std::complex<double>{ -poly[1] / poly[0] } };
+	}
+
+	template<>
+	std::array<std::complex<double>, 2> FixedPolynomial<2>::getSolutions() const {
+		std::array<std::complex<double>, 2> roots;
+		solveQuadratics(&poly[2], &poly[1], &poly[0], 1, roots.data());
+		return roots;
+	}
+
+	template<>
+	std::array<std::complex<double>, 3> FixedPolynomial<3>::getSolutions() const {
+		std::array<std::complex<double>, 3> roots;
+		solveCubics(&poly[3], &poly[2], &poly[1], &poly[0], 1, roots.data());
+		return roots;
+	}
+
+	template<>
+	std::array<std::complex<double>, 4> FixedPolynomial<4>::getSolutions() const {
+		std::array<std::complex<double>, 4> roots;
+		solveQuartics(&poly[4], &poly[3], &poly[2], &poly[1], &poly[0], 1, roots.data());
+		return roots;
+	}
+
+	namespace {
+
+		//Adds a root in zero for every trailing zero coefficient and returns the degree of the remaining polynomial
+		std::size_t stripZeroRoots(const std::vector<double>& poly, PolyResult& roots) {
+			if (poly.size() < 2)
+				return 0;
+
+			auto degree = poly.size() - 1;
+			while (degree > 0 && poly[degree] == 0) {
+				roots.emplace_back(0.0, 0.0);
+				--degree;
+			}
+			return degree;
+		}
+
+		//Composite deflation (Peters and Wilkinson): dividing by a factor whose roots have modulus r, the quotient is computed
+		//from the highest degree down to the largest term |a_k| r^(m - k) of the polynomial and from the constant term up to it,
+		//so that neither recurrence amplifies the rounding errors. Returns k
+		template<typename T>
+		std::size_t deflationSplit(const T* poly, std::size_t degree, double r) {
+			std::size_t split = degree;
+			if (r == 0)
+				return split;
+
+			auto largest = -std::numeric_limits<double>::infinity();
+			const auto logR = std::log(r);
+			for (std::size_t k = 0; k <= degree; ++k) {
+				//logarithms, since r^degree may overflow
+				const auto term = std::log(std::abs(poly[k])) + (degree - k) * logR;
+				if (term > largest) {
+					largest = term;
+					split = k;
+				}
+			}
+			return split;
+		}
+
+		//Logarithmic derivative p'(z) / p(z) (Horner's method), the inverse of the Newton correction, and backward error of z,
+		//that is |p(z)| divided by the sum of the |a_i| |z|^i. Outside the unit circle the reversed polynomial q(w) = w^n p(1 / w)
+		//is evaluated in w = 1 / z instead, which cannot overflow, and p'(z) / p(z) = (n q(w) - w q'(w)) / (z q(w)). Unlike the
+		//Newton correction it stays finite where p'(z) = 0, and it's infinite only where p(z) = 0, with a backward error of 0
+		double logarithmicDerivative(const double* poly, std::size_t degree, std::complex<double> z, std::complex<double>& result) {
+			const auto squaredModulus = std::norm(z);
+			const auto reversed = squaredModulus > 1;
+			const auto xRe = reversed ? z.real() / squaredModulus : z.real();
+			const auto xIm = reversed ? -z.imag() / squaredModulus : z.imag();
+			const auto modulus = std::sqrt(xRe * xRe + xIm * xIm);
+
+			auto valueRe = reversed ? poly[degree] : poly[0], valueIm = 0.0, derivativeRe = 0.0, derivativeIm = 0.0;
+			auto bound = std::fabs(valueRe);
+			for (std::size_t i = 1; i <= degree; ++i) {
+				const auto coefficient = reversed ? poly[degree - i] : poly[i];
+				const auto dRe = derivativeRe * xRe - derivativeIm * xIm + valueRe;
+				derivativeIm = derivativeRe * xIm + derivativeIm * xRe + valueIm;
+				derivativeRe = dRe;
+				const auto vRe = valueRe * xRe - valueIm * xIm + coefficient;
+				valueIm = valueRe * xIm + valueIm * xRe;
+				valueRe = vRe;
+				bound = bound * modulus + std::fabs(coefficient);
+			}
+
+			const std::complex<double> value{ valueRe, valueIm }, derivative{ derivativeRe, derivativeIm };
+			if (reversed)
+				result = (static_cast<double>(degree) - std::complex<double>{ xRe, xIm } * derivative / value) / z;
+			else
+				result = derivative / value;
+			return std::abs(value) / bound;
+		}
+
+		//Final pass on all the roots: Newton steps against the original coefficients with the other roots divided out implicitly
+		//(Maehly's method), so that a root that the deflations moved away cannot converge to a root already found
+		void polishRoots(const std::vector<double>& poly, PolyResult& roots) {
+			const auto degree = poly.size() - 1;
+			const auto epsilon = std::numeric_limits<double>::epsilon();
+			const auto maxSweeps = 100 + static_cast<int>(degree);
+			std::vector<char> converged(roots.size(), 0);
+
+			for (auto sweep = 0; sweep < maxSweeps; ++sweep) {
+				auto done = true;
+
+				for (std::size_t k = 0; k < roots.size(); ++k) {
+					if (converged[k])
+						continue;
+
+					std::complex<double> inverse;
+					if (logarithmicDerivative(poly.data(), degree, roots[k], inverse) <= 4 * epsilon) {
+						converged[k] = 1;
+						continue;
+					}
+
+					std::complex<double> sum{ 0 };
+					for (std::size_t j = 0; j < roots.size(); ++j)
+						if (j != k)
+							sum += 1.0 / (roots[k] - roots[j]);
+
+					//roots that coincide make the sum infinite: a plain Newton step separates them. A root is accepted only
+					//by its backward error, so where the step is not defined it just waits for the other roots to move
+					const auto separate = !std::isfinite(sum.real()) || !std::isfinite(sum.imag());
+					const auto step = 1.0 / (separate ? inverse : inverse - sum);
+					if (!std::isfinite(step.real()) || !std::isfinite(step.imag())) {
+						done = false;
+						continue;
+					}
+
+					//a step at rounding level ends the sweeps, but doesn't accept the root
+					roots[k] -= step;
+					if (std::abs(step) > 4 * epsilon * std::abs(roots[k]))
+						done = false;
+				}
+
+				if (done)
+					break;
+			}
+		}
+
+		//Laguerre's method with deflation; the quotients overwrite the coefficients of a single complex buffer
+		PolyResult laguerre(const std::vector<double>& poly) {
+			PolyResult roots;
+			const auto degree = stripZeroRoots(poly, roots);
+			if (degree == 0)
+				return roots;
+
+			std::vector<std::complex<double>> buffer(poly.begin(), poly.begin() + degree + 1);
+			roots.reserve(roots.size() + degree);
+
+			//fractional steps that break the (rare) limit cycles
+			const double fractions[] = { 0.5, 0.25, 0.75, 0.13, 0.38, 0.62, 0.88, 1.0 };
+			const auto epsilon = std::numeric_limits<double>::epsilon();
+			const auto maxIterations = 80, maxAttempts = 8;
+
+			//synthetic division of buffer[0..m] by (z - x), in place: buffer[0..m-1] becomes the quotient
+			const auto deflate = [&buffer](std::complex<double> x, std::size_t m) {
+				const auto split = deflationSplit(buffer.data(), m, std::abs(x));
+
+				//forward recurrence from the highest degree...
+				for (std::size_t j = 1; j < split; ++j)
+					buffer[j] += x * buffer[j - 1];
+
+				//...and backward recurrence from the constant term, which meet where the largest term is
+				if (split < m) {
+					auto quotient = -buffer[m] / x;
+					for (auto j = m - 1; j > split; --j) {
+						const auto coefficient = buffer[j];
+						buffer[j] = quotient;
+						quotient = (quotient - coefficient) / x;
+					}
+					buffer[split] = quotient;
+				}
+			};
+
+			//|p(z)| divided by the sum of the |a_i| |z|^i on buffer[0..m], reversed outside the unit circle like the iterations
+			const auto backwardError = [&buffer](std::complex<double> z, std::size_t m) {
+				const auto reversed = std::norm(z) > 1;
+				const auto point = reversed ? 1.0 / z : z;
+				const auto modulus = std::abs(point);
+				std::complex<double> value{ 0 };
+				auto bound = 0.0;
+				for (std::size_t j = 0; j <= m; ++j) {
+					const auto coefficient = buffer[reversed ? m - j : j];
+					value = value * point + coefficient;
+					bound = bound * modulus + std::abs(coefficient);
+				}
+				return std::abs(value) / bound;
+			};
+
+			auto m = degree;
+			while (m > 0) {
+				const auto n = static_cast<double>(m);
+				std::complex<double> x{ 0 }, best{ 0 };
+				auto bestValue = std::numeric_limits<double>::infinity();
+
+				//the iterations start in zero; when they do not converge (badly scaled coefficients may trap them in a cycle)
+				//they restart on the circle of the geometric mean of the roots' modules
+				for (auto attempt = 0; attempt < maxAttempts; ++attempt) {
+					if (attempt > 0)
+						x = std::polar(std::pow(std::abs(buffer[m] / buffer[0]), 1.0 / n), 0.4 + attempt * 2.0);
+
+					auto converged = false;
+					for (auto iteration = 1; iteration <= maxIterations; ++iteration) {
+						//outside the unit circle the iteration runs on the reversed polynomial, whose roots are the inverses,
+						//in w = 1 / x: the powers of x would overflow on high degrees
+						const auto reversed = std::norm(x) > 1;
+						const auto point = reversed ? 1.0 / x : x;
+
+						//value, first derivative and half the second derivative in point
+						auto value = buffer[reversed ? m : 0];
+						std::complex<double> first{ 0 }, half{ 0 };
+						const auto modulus = std::abs(point);
+						auto errorBound = std::abs(value);
+						for (std::size_t j = 1; j <= m; ++j) {
+							half = half * point + first;
+							first = first * point + value;
+							value = value * point + buffer[reversed ? m - j : j];
+							errorBound = std::abs(value) + modulus * errorBound;
+						}
+
+						if (std::abs(value) / errorBound < bestValue) {
+							bestValue = std::abs(value) / errorBound;
+							best = x;
+						}
+
+						if (std::abs(value) <= epsilon * errorBound) {
+							converged = true;
+							break;
+						}
+
+						const auto g = first / value;
+						const auto g2 = g * g;
+						const auto h = g2 - 2.0 * half / value;
+						const auto root = std::sqrt((n - 1) * (n * h - g2));
+						auto denominator = g + root;
+						if (std::abs(denominator) < std::abs(g - root))
+							denominator = g - root;
+
+						const auto step = std::abs(denominator) > 0 ? n / denominator : std::polar(1 + modulus, static_cast<double>(iteration));
+						const auto next = point - step;
+						if (next == point) {
+							converged = true;
+							break;
+						}
+
+						const auto nextPoint = (iteration % 10 != 0) ? next : point - fractions[(iteration / 10) % 8] * step;
+						if (reversed && nextPoint == 0.0)
+							break;
+						x = reversed ? 1.0 / nextPoint : nextPoint;
+					}
+
+					if (converged) {
+						best = x;
+						break;
+					}
+				}
+				x = best;
+
+				//real coefficients: the root is made real when its real part is as good a root of the deflated polynomial,
+				//otherwise its conjugate is a root too
+				if (x.imag() != 0 && backwardError(x.real(), m) <= std::max(backwardError(x, m), 4 * epsilon))
+					x.imag(0);
+
+				//the root is divided out of the deflated polynomial as it is (the remainder of the division is zero); the final
+				//pass polishes it on the original polynomial
+				roots.push_back(x);
+				deflate(x, m--);
+				if (x.imag() != 0 && m > 0) {
+					roots.push_back(std::conj(x));
+					deflate(std::conj(x), m--);
+
+					//the quotient by a conjugate pair is real: only rounding errors are left in the imaginary parts, which
+					//would otherwise turn the real roots into close complex pairs
+					for (std::size_t j = 0; j <= m; ++j)
+						buffer[j].imag(0);
+				}
+			}
+
+			polishRoots(poly, roots);
+			return roots;
+		}
+
+		//Adds the roots of z^2 - u*z - v to the result
+		void quadraticFactorRoots(double u, double v, PolyResult& roots) {
+			const auto discriminant = u * u + 4 * v;
+			if (discriminant >= 0) {
+				//the root with the larger modulus first, the other one from the product of the roots (no cancellation)
+				const auto q = 0.5 * (u + std::copysign(std::sqrt(discriminant), u));
+				roots.emplace_back(q, 0.0);
+				roots.emplace_back(q != 0 ? -v / q : 0.0, 0.0);
+			}
+			else {
+				const auto imag = 0.5 * std::sqrt(-discriminant);
+				roots.emplace_back(0.5 * u, imag);
+				roots.emplace_back(0.5 * u, -imag);
+			}
+		}
+
+		//Bairstow's method: quadratic factors z^2 - u*z - v are extracted in real arithmetic; the quotient and the
+		//partial derivatives live in buffers allocated once, which swap their roles after each deflation
+		PolyResult bairstow(const std::vector<double>& poly) {
+			PolyResult roots;
+			auto degree = stripZeroRoots(poly, roots);
+			if (degree == 0)
+				return roots;
+
+			std::vector<double> a(poly.begin(), poly.begin() + degree + 1), b(degree + 1), c(degree + 1);
+			roots.reserve(roots.size() + degree);
+
+			const auto pi = 3.14159265358979323846;
+			const auto epsilon = std::numeric_limits<double>::epsilon();
+			const auto maxIterations = 100, maxAttempts = 16;
+
+			while (degree > 2) {
+				const auto n = degree;
+				const auto radius = std::pow(std::fabs(a[n] / a[0]), 1.0 / n);
+				auto bestU = 0.0, bestV = 0.0, bestRemainder = std::numeric_limits<double>::infinity();
+
+				for (auto attempt = 0; attempt < maxAttempts; ++attempt) {
+					//the starting factor has its roots on the circle of the geometric mean of the roots' modules (on a smaller one
+					//in the second half of the attempts)
+					const auto angle = 0.4 + (attempt % 8) * pi / 8;
+					const auto startRadius = attempt < 8 ? radius : 0.6 * radius;
+					auto u = 2 * startRadius * std::cos(angle), v = -startRadius * startRadius;
+					auto converged = false;
+					auto previousStep = std::numeric_limits<double>::infinity();
+
+					for (auto iteration = 0; iteration < maxIterations; ++iteration) {
+						b[0] = a[0];
+						b[1] = a[1] + u * b[0];
+						for (std::size_t i = 2; i <= n; ++i)
+							b[i] = a[i] + u * b[i - 1] + v * b[i - 2];
+
+						c[0] = b[0];
+						c[1] = b[1] + u * c[0];
+						for (std::size_t i = 2; i < n; ++i)
+							c[i] = b[i] + u * c[i - 1] + v * c[i - 2];
+
+						const auto remainder = std::fabs(b[n - 1]) + std::fabs(b[n]);
+						if (remainder < bestRemainder && std::isfinite(u) && std::isfinite(v)) {
+							bestRemainder = remainder;
+							bestU = u;
+							bestV = v;
+						}
+
+						const auto determinant = c[n - 2] * c[n - 2] - c[n - 1] * c[n - 3];
+						if (determinant == 0 || !std::isfinite(determinant))
+							break;
+
+						const auto du = (-b[n - 1] * c[n - 2] + b[n] * c[n - 3]) / determinant;
+						const auto dv = (-b[n] * c[n - 2] + b[n - 1] * c[n - 1]) / determinant;
+						u += du;
+						v += dv;
+						if (!std::isfinite(u) || !std::isfinite(v))
+							break;
+
+						//converged when the step is below rounding or when it stops decreasing once it is already tiny
+						const auto step = std::fabs(du) + std::fabs(dv), scale = std::fabs(u) + std::fabs(v);
+						const auto stagnated = step <= 1e-8 * scale && step >= previousStep;
+						previousStep = step;
+						if (step <= 4 * epsilon * scale || stagnated) {
+							bestU = u;
+							bestV = v;
+							converged = true;
+							break;
+						}
+					}
+
+					if (converged)
+						break;
+				}
+
+				//deflation with the best factor found, the quotient is b[0..n-2]: composite like in Laguerre's method, the modulus
+				//of the factor's roots being sqrt|v|
+				const auto split = std::min(deflationSplit(a.data(), n, std::sqrt(std::fabs(bestV))), n - 1);
+				for (std::size_t i = 0; i < split; ++i)
+					b[i] = a[i] + (i >= 1 ? bestU * b[i - 1] : 0.0) + (i >= 2 ? bestV * b[i - 2] : 0.0);
+				auto next = 0.0, afterNext = 0.0;
+				for (auto i = n; i >= split + 2; --i) {
+					b[i - 2] = (afterNext - bestU * next - a[i]) / bestV;
+					afterNext = next;
+					next = b[i - 2];
+				}
+				std::swap(a, b);
+
+				quadraticFactorRoots(bestU, bestV, roots);
+				degree -= 2;
+			}
+
+			if (degree == 2)
+				quadraticFactorRoots(-a[1] / a[0], -a[2] / a[0], roots);
+			else
+				roots.emplace_back(-a[1] / a[0], 0.0);
+
+			polishRoots(poly, roots);
+			return roots;
+		}
+
+		//Adds 1 / (z - points[j]) for every j in [from, to) to the sum (real and imaginary parts kept apart so that the loop vectorizes)
+		void sumInverseDistances(const double* re, const double* im, std::size_t from, std::size_t to, double zRe, double zIm, double& sumRe, double& sumIm) {
+			for (auto j = from; j < to; ++j) {
+				const auto dRe = zRe - re[j];
+				const auto dIm = zIm - im[j];
+				const auto inverseSquare = 1.0 / (dRe * dRe + dIm * dIm);
+				sumRe += dRe * inverseSquare;
+				sumIm -= dIm * inverseSquare;
+			}
+		}
+
+		//Aberth-Ehrlich method on the coefficients, highest degree first: every root is corrected at once in each sweep
+		PolyResult aberthEhrlich(const std::vector<double>& poly) {
+			PolyResult roots;
+			const auto degree = stripZeroRoots(poly, roots);
+			if (degree == 0)
+				return roots;
+
+			//initial guesses on circles whose radii come from the upper convex hull of the points (i, log|a_i|), i being
+			//the power of the coefficient: an edge from i to j of the hull holds j - i roots of modulus close to
+			//(|a_i| / |a_j|)^(1 / (j - i)). The angular offset breaks the symmetry with respect to the real axis, which
+			//real coefficients would otherwise preserve
+			const auto pi = 3.14159265358979323846;
+			std::vector<double> re(degree), im(degree), stepRe(degree, 0), stepIm(degree, 0);
+			std::vector<char> converged(degree, 0);
+			std::vector<std::size_t> hull;
+			const auto logModule = [&](std::size_t power) { return std::log(std::fabs(poly[degree - power])); };
+			for (std::size_t power = 0; power <= degree; ++power) {
+				if (poly[degree - power] == 0)
+					continue;
+
+				while (hull.size() >= 2) {
+					const auto i = hull[hull.size() - 2], j = hull.back();
+					if ((logModule(j) - logModule(i)) * (power - i) > (logModule(power) - logModule(i)) * (j - i))
+						break;
+					hull.pop_back();
+				}
+				hull.push_back(power);
+			}
+
+			for (std::size_t edge = 1, k = 0; edge < hull.size(); ++edge) {
+				const auto i = hull[edge - 1], j = hull[edge];
+				const auto count = j - i;
+				const auto radius = std::exp((logModule(i) - logModule(j)) / count);
+				for (std::size_t h = 0; h < count; ++h, ++k) {
+					const auto angle = 2 * pi * h / count + 2 * pi * edge / degree + 0.4;
+					re[k] = radius * std::cos(angle);
+					im[k] = radius * std::sin(angle);
+				}
+			}
+
+			const auto epsilon = std::numeric_limits<double>::epsilon();
+			const auto maxIterations = 100 + static_cast<int>(degree);
+			for (auto iteration = 0; iteration < maxIterations; ++iteration) {
+				auto done = true;
+
+				for (std::size_t k = 0; k < degree; ++k) {
+					stepRe[k] = stepIm[k] = 0;
+					if (converged[k])
+						continue;
+
+					//z is as accurate as the arithmetic allows when p(z) is below its rounding error
+					const auto zRe = re[k], zIm = im[k];
+					std::complex<double> inverse;
+					if (logarithmicDerivative(poly.data(), degree, { zRe, zIm }, inverse) <= 4 * epsilon) {
+						converged[k] = 1;
+						continue;
+					}
+
+					auto sumRe = 0.0, sumIm = 0.0;
+					sumInverseDistances(re.data(), im.data(), 0, k, zRe, zIm, sumRe, sumIm);
+					sumInverseDistances(re.data(), im.data(), k + 1, degree, zRe, zIm, sumRe, sumIm);
+
+					//p(z) / (p'(z) - p(z) sum), finite where p'(z) = 0; when it's not defined the root waits for the others to
+					//move, since only the backward error accepts it
+					const auto step = 1.0 / (inverse - std::complex<double>{ sumRe, sumIm });
+					if (!std::isfinite(step.real()) || !std::isfinite(step.imag())) {
+						done = false;
+						continue;
+					}
+
+					//a step at rounding level ends the sweeps, but doesn't accept the root
+					stepRe[k] = step.real();
+					stepIm[k] = step.imag();
+					if (std::abs(step) > 4 * epsilon * std::hypot(zRe, zIm))
+						done = false;
+				}
+
+				//the corrections are applied after the sweep so that every root uses the same approximations
+				for (std::size_t k = 0; k < degree; ++k) {
+					re[k] -= stepRe[k];
+					im[k] -= stepIm[k];
+				}
+
+				if (done)
+					break;
+			}
+
+			for (std::size_t k = 0; k < degree; ++k)
+				roots.emplace_back(re[k], im[k]);
+
+			return roots;
+		}
+
+	}
+
 	void PolyEquation::init() {
 		//Laguerre
 		algorithm[PolyAlgorithm::Laguerre] = [](const std::vector<double>& points) {
-			//missing implementation, will do it soon...
-			return PolyResult{};
+			return laguerre(points);
 		};
 
 		//Bairstrow
 		algorithm[PolyAlgorithm::Bairstrow] = [](const std::vector<double>& points) {
-			//missing implementation, will do it soon...
-			return PolyResult{};
+			return bairstow(points);
+		};
+
+		//Aberth-Ehrlich
+		algorithm[PolyAlgorithm::Aberth] = [](const std::vector<double>& points) {
+			return aberthEhrlich(points);
 		};
 	}
 
@@ -2,12 +2,21 @@
 #define EQUATION_H
 
 #include <map>
+#include <limits>
+#include <cstdint>
+#include <array>
 #include <tuple>
 #include <vector>
+#include <type_traits>
 #include <string>
+#include <memory>
 #include <complex>
 #include <functional>
+#include <utility>
 #include "Parser/fparser.hh"
+#include "Parser/fparser_jit.hh"
+#include "Parser/fparser_interval.hh"
+#include "Parser/fparser_cache.hh"
 
 namespace NA_Equation {
 
@@ -25,41 +34,303 @@ namespace NA_Equation {
 		int getDegree() const;
 		Polynomial getDerivative() const;
 		double evaluateOn(double x) const;
+		void evaluateOn(const double* xs, double* out, std::size_t n) const;
 		double operator[](int x);
 		const std::vector<double>& toStdVector() const;
 	};
 
+	//Polynomial whose degree is known at compile time: the coefficients (from the highest degree, like Polynomial) are stored
+	//inline, so evaluation, derivative and deflation allocate nothing and the loops are fully unrolled
+	template<std::size_t N>
+	struct FixedPolynomial {
+	private:
+		std::array<double, N + 1> poly;
+
+		//Before C++17 the elements of a std::array cannot be assigned in a constant expression, so the coefficients of the
+		//derivative and of the quotient are computed in a plain array and copied at the end
+		template<std::size_t... I>
+		static constexpr FixedPolynomial<(N > 0 ? N - 1 : 0)> fromArray(const double (&x)[N > 0 ? N : 1], std::index_sequence<I...>) {
+			return FixedPolynomial<(N > 0 ? N - 1 : 0)>{ std::array<double, (N > 0 ? N : 1)>{ { x[I]... } } };
+		}
+	public:
+		constexpr explicit FixedPolynomial(const std::array<double, N + 1>& x)
+			: poly(x[0] != 0 ? x : throw std::runtime_error("The highest degree coefficient cannot be zero")) {}
+		static constexpr int getDegree() { return static_cast<int>(N); }
+
+		constexpr double evaluateOn(double x) const {
+			auto result = poly[0];
+			for (std::size_t i = 1; i <= N; ++i)
+				result = result * x + poly[i];
+			return result;
+		}
+
+		constexpr FixedPolynomial<(N > 0 ? N - 1 : 0)> getDerivative() const {
+			static_assert(N > 0, "A constant has no derivative");
+			double temp[N > 0 ? N : 1]{};
+			for (std::size_t i = 0; i < N; ++i)
+				temp[i] = poly[i] * static_cast<double>(N - i);
+			return fromArray(temp, std::make_index_sequence<(N > 0 ? N : 1)>{});
+		}
+
+		//Quotient of the division by (x - root) with Horner's scheme; the remainder is the value in root
+		constexpr FixedPolynomial<(N > 0 ? N - 1 : 0)> deflate(double root) const {
+			static_assert(N > 0, "A constant cannot be deflated");
+			double temp[N > 0 ? N : 1]{};
+			temp[0] = poly[0];
+			for (std::size_t i = 1; i < N; ++i)
+				temp[i] = temp[i - 1] * root + poly[i];
+			return fromArray(temp, std::make_index_sequence<(N > 0 ? N : 1)>{});
+		}
+
+		//Closed formulas, available for the degrees from 1 to 4
+		std::array<std::complex<double>, N> getSolutions() const;
+
+		constexpr double operator[](std::size_t x) const { return poly[x]; }
+		constexpr const std::array<double, N + 1>& toStdArray() const { return poly; }
+	};
+
+	template<std::size_t N>
+	std::array<std::complex<double>, N> FixedPolynomial<N>::getSolutions() const {
+		static_assert(N >= 1 && N <= 4, "There are no closed formulas above the 4th degree, use PolyEquation");
+		return {};
+	}
+
+	template<> std::array<std::complex<double>, 1> FixedPolynomial<1>::getSolutions() const;
+	template<> std::array<std::complex<double>, 2> FixedPolynomial<2>::getSolutions() const;
+	template<> std::array<std::complex<double>, 3> FixedPolynomial<3>::getSolutions() const;
+	template<> std::array<std::complex<double>, 4> FixedPolynomial<4>::getSolutions() const;
+
 	using Result = std::tuple<double, double, std::vector<double>>;
-	using AlgorithmCode = std::function<Result(std::vector<double>, bool)>;
-	enum class Algorithm { Newton = 0, NewtonWithMultiplicity = 1, Secant = 2 };
+	//Peephole keeps the bytecode as the parser emits it (constant folding and the other rules applied while parsing, which
+	//cannot be turned off), Full runs the optimizer of fparser on it as well: slower to build, faster to evaluate
+	enum class Optimization { Peephole = 0, Full = 1 };
+
+	enum class Algorithm { Newton = 0, NewtonWithMultiplicity = 1, Secant = 2, Brent = 3, Illinois = 4, AndersonBjorck = 5, ITP = 6, Ridders = 7 };
+
+	//Input of Equation::solve(): secondGuess is used by the secant method (the second initial guess) and by the bracketing
+	//methods (guess and secondGuess are the bounds of the interval), multiplicity only by NewtonWithMultiplicity
+	struct SolverParameters {
+		double guess = 0;
+		double secondGuess = 0;
+		double tolerance = 1.0e-10;
+		int maxIter = 20;
+		int multiplicity = 1;
+	};
+
+	enum class SolveStatus { Converged = 0, MaxIterations = 1 };
+
+	//How Equation::continuation() guesses the next root: Secant extrapolates the last two roots, Tangent follows the
+	//derivative of the root with respect to the parameters (dx/dp = -df/dp / df/dx)
+	enum class Predictor { Secant = 0, Tangent = 1 };
+
+	//Output of Equation::solve(), a plain struct without allocations
+	struct SolveResult {
+		double root;
+		double residual;
+		int iterations;
+		SolveStatus status;
+	};
+
+	//Bounds of x, or of f(x) (empty, with lower > upper, when f is not defined anywhere in x)
+	using Interval = FunctionParserInterval::Interval;
+
+	//Constants, units and functions shared by a fleet of equations, made once from a FunctionParser to which they have been
+	//added with AddConstant(), AddUnit() and AddFunction()
+	using SymbolTable = FunctionParser::SymbolTable;
+
+	//Output of Equation::isolateRoots(): a Unique interval contains exactly one root (proven by the interval Newton method),
+	//a Possible one is not wider than the resolution (or merges a few adjacent ones) and may contain one root, several
+	//close roots, a multiple root or none, where f is too close to zero to tell
+	enum class RootStatus { Unique = 0, Possible = 1 };
+	struct RootInterval {
+		double lower;
+		double upper;
+		RootStatus status;
+	};
+
+	//Measures of a single solve, filled by Equation::solve() when it is given one. lastStep is the distance between the last
+	//two estimates
+	struct SolveStats {
+		std::int64_t nanoseconds = 0;
+		int iterations = 0;
+		int evaluations = 0;
+		int derivativeEvaluations = 0;
+		double lastStep = 0;
+		double residual = 0;
+		SolveStatus status = SolveStatus::Converged;
+	};
+
+	//Totals of many solves; the summaries of different threads can be merged with +=
+	struct SolveStatsSummary {
+		std::size_t solves = 0;
+		std::size_t converged = 0;
+		std::int64_t nanoseconds = 0;
+		std::int64_t minNanoseconds = std::numeric_limits<std::int64_t>::max();
+		std::int64_t maxNanoseconds = 0;
+		long long iterations = 0;
+		long long evaluations = 0;
+		long long derivativeEvaluations = 0;
+		double maxResidual = 0;
+
+		void add(const SolveStats& stats);
+		SolveStatsSummary& operator+=(const SolveStatsSummary& other);
+		double meanNanoseconds() const;
+		double meanIterations() const;
+		double meanEvaluations() const;
+	};
+
+	//Receives the estimates of Equation::solve(), one at a time. It only refers to the callable given to the constructor
+	//(a lambda, a TraceBuffer...) which must live until the end of the solve
+	class IterationSink {
+	private:
+		void* target;
+		void(*call)(void*, double);
+	public:
+		template<typename F, typename = std::enable_if_t<!std::is_same<std::decay_t<F>, IterationSink>::value>,
+			typename = decltype(std::declval<F&>()(0.0))>
+		IterationSink(F&& f) : target(const_cast<void*>(static_cast<const void*>(std::addressof(f)))),
+			call([](void* t, double x) { (*static_cast<std::remove_reference_t<F>*>(t))(x); }) {}
+		void operator()(double x) const { call(target, x); }
+	};
+
+	//Ring buffer on a storage of the caller: it keeps the last 'capacity' estimates, the oldest at index 0
+	class TraceBuffer {
+	private:
+		double* data;
+		std::size_t capacity, count;
+	public:
+		TraceBuffer(double* storage, std::size_t size) : data(storage), capacity(size), count(0) {}
+		void operator()(double x) {
+			if (capacity > 0)
+				data[count % capacity] = x;
+			++count;
+		}
+		std::size_t size() const { return count < capacity ? count : capacity; }
+		std::size_t received() const { return count; }
+		double operator[](std::size_t i) const { return data[(count - size() + i) % capacity]; }
+		void clear() { count = 0; }
+	};
 
 	class Equation final {
 	private:
-		const double h = 1.0e-13;
+		//what an evaluation needs, one per thread: the context of the parser and the values of the variables (the unknown
+		//in vars[0], then the parameters)
+		struct Context {
+			FunctionParser::EvalContext eval;
+			std::vector<double> vars;
+		};
 
 		double x;
 		double time;
 		std::string expr;
+		std::vector<std::string> parameterNames;
 		FunctionParser parser;
-		std::map<Algorithm, AlgorithmCode> algorithmList;
-	protected:
-		void init();
+		std::shared_ptr<FunctionParserJIT> native;
+		std::shared_ptr<FunctionParser> derivativeParser;
+		std::shared_ptr<FunctionParserJIT> nativeDerivative;
+		std::shared_ptr<FunctionParserInterval> intervalFunction;
+		std::shared_ptr<FunctionParserInterval> intervalDerivative;
+		Context context;
+
+		//builds intervalFunction (and intervalDerivative when f' can be differentiated and evaluated on intervals)
+		void compileIntervals();
+
+		//thread-safe versions used by the algorithms (one context per thread)
+		double evaluateOn(double x, Context& context) const;
+		double evaluateDerivative(double x, Context& context) const;
+		double evaluateWithDerivative(double x, double& derivative, Context& context) const;
+		//the same, counted in the statistics (if any)
+		double evaluateOn(double x, Context& context, SolveStats* stats) const;
+		double evaluateWithDerivative(double x, double& derivative, Context& context, SolveStats* stats) const;
+
+		//the algorithms, specialized in Equation.cpp
+		template<Algorithm A>
+		SolveResult run(const SolverParameters& parameters, const IterationSink* trace, SolveStats* stats, Context& context) const;
+		SolveResult dispatch(Algorithm algorithm, const SolverParameters& parameters, const IterationSink* trace, SolveStats* stats,
+			Context& context) const;
+		SolveResult profile(Algorithm algorithm, const SolverParameters& parameters, const IterationSink* trace, SolveStats& stats,
+			Context& context) const;
+		Result collect(Algorithm algorithm, const SolverParameters& parameters, bool guessList, Context& context) const;
 	public:
-		Equation(const std::string& expression) : expr(expression), x(0), time(0) {
-			parser.Parse(this->expr, "x");
-			init();
+		//the bytecode comes from FunctionParserCache<double>::global(): equations with the same expression (and copies of an
+		//Equation) share it, and it's parsed and optimized only the first time
+		Equation(const std::string& expression, Optimization level = Optimization::Full) : x(0), time(0), expr(expression) {
+			FunctionParserCache<double>::global().Parse(parser, this->expr, "x", false, level == Optimization::Full);
+			context.vars.assign(1, 0.0);
 		}
-		Equation(std::string&& expression) : expr(std::move(expression)), x(0), time(0) {
-			parser.Parse(this->expr, "x");
-			init();
+		Equation(std::string&& expression, Optimization level = Optimization::Full) : x(0), time(0), expr(std::move(expression)) {
+			FunctionParserCache<double>::global().Parse(parser, this->expr, "x", false, level == Optimization::Full);
+			context.vars.assign(1, 0.0);
 		}
+		//the unknown and the parameters of the expression, for example "x; a, b, c": the parameters are constants of the
+		//equation (0 until they are set) and changing them doesn't parse the expression again
+		Equation(const std::string& expression, const std::string& variables, Optimization level = Optimization::Full);
+		//the names which are not variables are looked up in symbols, shared by every equation built with it instead of being
+		//copied into each one; the bytecode doesn't come from the cache, which doesn't know the symbols
+		Equation(const std::string& expression, const SymbolTable& symbols, Optimization level = Optimization::Full)
+			: Equation(expression, "x", symbols, level) {
+		}
+		Equation(const std::string& expression, const std::string& variables, const SymbolTable& symbols,
+			Optimization level = Optimization::Full);
+		std::size_t parameterCount() const;
+		//the index of a parameter in parameters(), in the order of the declaration
+		std::size_t parameterSlot(const std::string& name) const;
+		const std::string& parameterName(std::size_t slot) const;
+		double* parameters();
+		const double* parameters() const;
+		void setParameter(const std::string& name, double value);
+		bool compileNative();
+		bool compileDerivative();
 		double evaluateOn(double x);
+		void evaluateOn(const double* xs, double* out, std::size_t n);
 		double elapsedMilliseconds() const;
 		double evaluateDerivative(double x);
 		Result solveEquation(double guess);
 		Result solveEquation(Algorithm algorithm, const std::vector<double>& inputList, bool guessList = false);
+		//same as solveEquation() with the algorithm chosen at compile time: no lookup, no copy of the parameters and no
+		//allocation. The estimates, if needed, go to the trace; elapsedMilliseconds() is not updated
+		template<Algorithm A>
+		SolveResult solve(const SolverParameters& parameters) { return run<A>(parameters, nullptr, nullptr, context); }
+		template<Algorithm A>
+		SolveResult solve(const SolverParameters& parameters, const IterationSink& trace) { return run<A>(parameters, &trace, nullptr, context); }
+		//the same, measured in the stats: they cost two clock readings and a few counters
+		template<Algorithm A>
+		SolveResult solve(const SolverParameters& parameters, SolveStats& stats) { return profile(A, parameters, nullptr, stats, context); }
+		template<Algorithm A>
+		SolveResult solve(const SolverParameters& parameters, const IterationSink& trace, SolveStats& stats) { return profile(A, parameters, &trace, stats, context); }
+		std::vector<Result> solveParallel(Algorithm algorithm, const std::vector<double>& guesses, const std::vector<double>& parameters,
+			double rootTolerance = 1.0e-8, double residualTolerance = 1.0e-6, bool guessList = false);
+		std::vector<Result> solveParallel(Algorithm algorithm, double from, double to, std::size_t points, const std::vector<double>& parameters,
+			double rootTolerance = 1.0e-8, double residualTolerance = 1.0e-6, bool guessList = false);
+		//Solves f(x; p) = 0 for 'count' vectors of parameters, stored one after the other in 'values' (parameterCount() each),
+		//and writes the i-th solution in results[i]. The vectors are split in chunks solved on all the cores; within a chunk
+		//every solve starts from the root of the previous one, so neighboring vectors should give neighboring roots
+		void sweep(Algorithm algorithm, const SolverParameters& parameters, const double* values, std::size_t count, SolveResult* results);
+		//Follows a single root along a path of parameter vectors (same layout of sweep()): the root of the first one is found
+		//with Newton's method from parameters.guess, then every root is predicted from the previous ones and corrected with
+		//Newton's method. When a correction is slow, fails or moves the root farther than the prediction the step is halved
+		//(intermediate vectors on the segment), and it's doubled again while the corrections are quick. The solves run one
+		//after the other on this thread; the return value is the number of vectors followed, the results of the others are NaN
+		std::size_t continuation(Predictor predictor, const SolverParameters& parameters, const double* values, std::size_t count, SolveResult* results);
+		//Bounds of f on the whole interval x, with the current parameters: every f(x) is inside the result even with the
+		//rounding errors. Comparisons, logical operators, if() and mod have no interval version and raise an exception
+		Interval evaluateOn(const Interval& x);
+		//Finds all the roots in [from, to] with interval arithmetic: the subintervals where the bounds of f exclude zero are
+		//dropped, the others are narrowed by the interval Newton method (where f' has bounds excluding zero) or bisected
+		//until they are narrower than the resolution. The result is ordered; no root in [from, to] is missed, except where f
+		//isn't continuous
+		std::vector<RootInterval> isolateRoots(double from, double to, double resolution = 1.0e-10);
 	};
 
+	template<> SolveResult Equation::run<Algorithm::Newton>(const SolverParameters&, const IterationSink*, SolveStats*, Context&) const;
+	template<> SolveResult Equation::run<Algorithm::NewtonWithMultiplicity>(const SolverParameters&, const IterationSink*, SolveStats*, Context&) const;
+	template<> SolveResult Equation::run<Algorithm::Secant>(const SolverParameters&, const IterationSink*, SolveStats*, Context&) const;
+	template<> SolveResult Equation::run<Algorithm::Brent>(const SolverParameters&, const IterationSink*, SolveStats*, Context&) const;
+	template<> SolveResult Equation::run<Algorithm::Illinois>(const SolverParameters&, const IterationSink*, SolveStats*, Context&) const;
+	template<> SolveResult Equation::run<Algorithm::AndersonBjorck>(const SolverParameters&, const IterationSink*, SolveStats*, Context&) const;
+	template<> SolveResult Equation::run<Algorithm::ITP>(const SolverParameters&, const IterationSink*, SolveStats*, Context&) const;
+	template<> SolveResult Equation::run<Algorithm::Ridders>(const SolverParameters&, const IterationSink*, SolveStats*, Context&) const;
+
 	using PolyResult = std::vector<std::complex<double>>;
 
 	class PolyBase {
@@ -104,9 +375,15 @@ namespace NA_Equation {
 		double getDiscriminant() const;
 	};
 
+	//Roots of n polynomials at once, structure of arrays: the i-th polynomial has the coefficients a[i], b[i], ... given from the
+	//lower degree like in the constructors above, and its roots go to roots[degree * i] ... roots[degree * i + degree - 1]
+	void solveQuadratics(const double* a, const double* b, const double* c, std::size_t n, std::complex<double>* roots);
+	void solveCubics(const double* a, const double* b, const double* c, const double* d, std::size_t n, std::complex<double>* roots);
+	void solveQuartics(const double* a, const double* b, const double* c, const double* d, const double* e, std::size_t n, std::complex<double>* roots);
+
 	using PolyResult = std::vector<std::complex<double>>;
 	using PolyCode = std::function<PolyResult(std::vector<double>)>;
-	enum class PolyAlgorithm { Laguerre = 0, Bairstrow = 1 };
+	enum class PolyAlgorithm { Laguerre = 0, Bairstrow = 1, Aberth = 2 };
 
 	class PolyEquation : public PolyBase {
 	private:
@@ -114,7 +391,7 @@ namespace NA_Equation {
 		PolyAlgorithm method;
 		void init();
 	public:
-		explicit PolyEquation(const std::vector<double>& coeff, PolyAlgorithm method_) : PolyBase(coeff), method(method_) { init(); }
+		explicit PolyEquation(const std::vector<double>& coeff, PolyAlgorithm method_) : PolyBase({ coeff.rbegin(), coeff.rend() }), method(method_) { init(); }
 		PolyResult getSolutions() const override;
 	};
 }
@@ -1,9 +1,9 @@
 #ifndef FRACTION_H
-#define FRACTION_h
+#define FRACTION_H
 
 #include <string>
 #include <optional>
-#include <exception>
+#include <stdexcept>
 
 namespace NA_Fraction {
 
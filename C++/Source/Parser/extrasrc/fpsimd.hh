@@ -0,0 +1,273 @@
+/***************************************************************************\
+|* Function Parser for C++ v4.5.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Copyright: Juha Nieminen, Joel Yliluoma                                 *|
+|*                                                                         *|
+|* This library is distributed under the terms of the                      *|
+|* GNU Lesser General Public License version 3.                            *|
+|* (See lgpl.txt and gpl.txt for the license text.)                        *|
+\***************************************************************************/
+
+// NOTE:
+// This file contains only internal functions for the function parser
+// library. You don't need to include this file in your code. Include
+// "fparser.hh" only.
+
+#ifndef ONCE_FPARSER_SIMD_H_
+#define ONCE_FPARSER_SIMD_H_
+
+#include "fpaux.hh"
+
+/* The kernels below are used by EvalBatch() for the arithmetic opcodes.
+   The double versions use the widest vector instructions supported by the
+   CPU, chosen at runtime. Only correctly rounded IEEE operations (add, sub,
+   mul, div and sqrt) are vectorized, and the leftover elements of a column
+   are computed with the very same scalar operations, so every instruction
+   set produces results identical to Eval().
+ */
+#if !defined(FP_DISABLE_DOUBLE_TYPE) && !defined(FP_NO_SIMD_EVAL)
+# if defined(__x86_64__) || defined(_M_X64)
+#  define FP_SIMD_EVAL_X86
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#   include <intrin.h>
+#  endif
+# elif defined(__aarch64__) || defined(_M_ARM64)
+#  define FP_SIMD_EVAL_NEON
+#  include <arm_neon.h>
+# endif
+#endif
+
+#ifdef ONCE_FPARSER_H_
+namespace FUNCTIONPARSERTYPES
+{
+    template<typename Value_t>
+    struct BatchKernels
+    {
+        static void add(Value_t* y, const Value_t* x, unsigned n)
+        { for(unsigned i = 0; i < n; ++i) y[i] += x[i]; }
+
+        static void sub(Value_t* y, const Value_t* x, unsigned n)
+        { for(unsigned i = 0; i < n; ++i) y[i] -= x[i]; }
+
+        static void mul(Value_t* y, const Value_t* x, unsigned n)
+        { for(unsigned i = 0; i < n; ++i) y[i] *= x[i]; }
+
+        static void div(Value_t* y, const Value_t* x, unsigned n)
+        { for(unsigned i = 0; i < n; ++i) y[i] /= x[i]; }
+
+        static void rsub(Value_t* y, const Value_t* x, unsigned n)
+        { for(unsigned i = 0; i < n; ++i) y[i] = x[i] - y[i]; }
+
+        static void rdiv(Value_t* y, const Value_t* x, unsigned n)
+        { for(unsigned i = 0; i < n; ++i) y[i] = x[i] / y[i]; }
+
+        static void neg(Value_t* x, unsigned n)
+        { for(unsigned i = 0; i < n; ++i) x[i] = -x[i]; }
+
+        static void sqr(Value_t* x, unsigned n)
+        { for(unsigned i = 0; i < n; ++i) x[i] = x[i]*x[i]; }
+
+        static void sqrt(Value_t* x, unsigned n)
+        { for(unsigned i = 0; i < n; ++i) x[i] = fp_sqrt(x[i]); }
+
+        static void inv(Value_t* x, unsigned n)
+        { for(unsigned i = 0; i < n; ++i) x[i] = Value_t(1)/x[i]; }
+
+        static void rsqrt(Value_t* x, unsigned n)
+        { for(unsigned i = 0; i < n; ++i) x[i] = Value_t(1) / fp_sqrt(x[i]); }
+    };
+
+#if defined(FP_SIMD_EVAL_X86) || defined(FP_SIMD_EVAL_NEON)
+    struct BatchKernelTable
+    {
+        const char* isa;
+        void (*add)(double*, const double*, unsigned);
+        void (*sub)(double*, const double*, unsigned);
+        void (*mul)(double*, const double*, unsigned);
+        void (*div)(double*, const double*, unsigned);
+        void (*rsub)(double*, const double*, unsigned);
+        void (*rdiv)(double*, const double*, unsigned);
+        void (*neg)(double*, unsigned);
+        void (*sqr)(double*, unsigned);
+        void (*sqrt)(double*, unsigned);
+        void (*inv)(double*, unsigned);
+        void (*rsqrt)(double*, unsigned);
+    };
+
+// Vectorized loop over a column with a scalar loop for the leftovers.
+#define FP_SIMD_LOOP(Width, vectorStep, scalarStep) \
+    unsigned i = 0; \
+    for(; i + (Width) <= n; i += (Width)) { vectorStep; } \
+    for(; i < n; ++i) { scalarStep; }
+
+// Defines the kernels of one instruction set and its kernel table.
+#define FP_SIMD_KERNELS(Isa, Attributes, Width, Vec, \
+                        Load, Store, Set1, Add, Sub, Mul, Div, Sqrt) \
+    namespace Isa \
+    { \
+        Attributes inline void add(double* y, const double* x, unsigned n) \
+        { FP_SIMD_LOOP(Width, (Store(y+i, Add(Load(y+i), Load(x+i)))), \
+                       (y[i] += x[i])) } \
+        Attributes inline void sub(double* y, const double* x, unsigned n) \
+        { FP_SIMD_LOOP(Width, (Store(y+i, Sub(Load(y+i), Load(x+i)))), \
+                       (y[i] -= x[i])) } \
+        Attributes inline void mul(double* y, const double* x, unsigned n) \
+        { FP_SIMD_LOOP(Width, (Store(y+i, Mul(Load(y+i), Load(x+i)))), \
+                       (y[i] *= x[i])) } \
+        Attributes inline void div(double* y, const double* x, unsigned n) \
+        { FP_SIMD_LOOP(Width, (Store(y+i, Div(Load(y+i), Load(x+i)))), \
+                       (y[i] /= x[i])) } \
+        Attributes inline void rsub(double* y, const double* x, unsigned n) \
+        { FP_SIMD_LOOP(Width, (Store(y+i, Sub(Load(x+i), Load(y+i)))), \
+                       (y[i] = x[i] - y[i])) } \
+        Attributes inline void rdiv(double* y, const double* x, unsigned n) \
+        { FP_SIMD_LOOP(Width, (Store(y+i, Div(Load(x+i), Load(y+i)))), \
+                       (y[i] = x[i] / y[i])) } \
+        /* -0.0 - x flips the sign bit exactly like -x, also for zeros. */ \
+        Attributes inline void neg(double* x, unsigned n) \
+        { const Vec negZero = Set1(-0.0); \
+          FP_SIMD_LOOP(Width, (Store(x+i, Sub(negZero, Load(x+i)))), \
+                       (x[i] = -x[i])) } \
+        Attributes inline void sqr(double* x, unsigned n) \
+        { FP_SIMD_LOOP(Width, (Store(x+i, Mul(Load(x+i), Load(x+i)))), \
+                       (x[i] = x[i]*x[i])) } \
+        Attributes inline void sqrt(double* x, unsigned n) \
+        { FP_SIMD_LOOP(Width, (Store(x+i, Sqrt(Load(x+i)))), \
+                       (x[i] = std::sqrt(x[i]))) } \
+        Attributes inline void inv(double* x, unsigned n) \
+        { const Vec one = Set1(1.0); \
+          FP_SIMD_LOOP(Width, (Store(x+i, Div(one, Load(x+i)))), \
+                       (x[i] = 1.0/x[i])) } \
+        Attributes inline void rsqrt(double* x, unsigned n) \
+        { const Vec one = Set1(1.0); \
+          FP_SIMD_LOOP(Width, (Store(x+i, Div(one, Sqrt(Load(x+i))))), \
+                       (x[i] = 1.0 / std::sqrt(x[i]))) } \
+        inline const BatchKernelTable& table() \
+        { \
+            static const BatchKernelTable kernels = \
+                { #Isa, add, sub, mul, div, rsub, rdiv, \
+                  neg, sqr, sqrt, inv, rsqrt }; \
+            return kernels; \
+        } \
+    }
+
+#ifdef FP_SIMD_EVAL_X86
+#if defined(__GNUC__) || defined(__clang__)
+# define FP_SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+# define FP_SIMD_TARGET(isa)
+#endif
+
+    FP_SIMD_KERNELS(sse2, , 2, __m128d,
+                    _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd,
+                    _mm_add_pd, _mm_sub_pd, _mm_mul_pd, _mm_div_pd,
+                    _mm_sqrt_pd)
+
+    FP_SIMD_KERNELS(avx2, FP_SIMD_TARGET("avx2"), 4, __m256d,
+                    _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd,
+                    _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd,
+                    _mm256_div_pd, _mm256_sqrt_pd)
+
+    /* _mm512_sqrt_pd() merges into _mm512_undefined_pd(), which GCC reports
+       with -Wmaybe-uninitialized. The zero-masking version with all the
+       lanes selected compiles to the same vsqrtpd. */
+    FP_SIMD_TARGET("avx512f") inline __m512d fp_mm512_sqrt_pd(__m512d x)
+    { return _mm512_maskz_sqrt_pd(__mmask8(0xFF), x); }
+
+    FP_SIMD_KERNELS(avx512, FP_SIMD_TARGET("avx512f"), 8, __m512d,
+                    _mm512_loadu_pd, _mm512_storeu_pd, _mm512_set1_pd,
+                    _mm512_add_pd, _mm512_sub_pd, _mm512_mul_pd,
+                    _mm512_div_pd, fp_mm512_sqrt_pd)
+
+    inline const BatchKernelTable& selectBatchKernels()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+        __cpuid(info, 1);
+        // The OS must save the AVX (and AVX-512) registers on context switch
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+        const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+        if(maxLeaf >= 7 && avx && (xcr0 & 0x6) == 0x6)
+        {
+            __cpuidex(info, 7, 0);
+            if((info[1] & (1 << 16)) && (xcr0 & 0xE6) == 0xE6)
+                return avx512::table();
+            if(info[1] & (1 << 5))
+                return avx2::table();
+        }
+#else
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f")) return avx512::table();
+        if(__builtin_cpu_supports("avx2")) return avx2::table();
+#endif
+        return sse2::table();
+    }
+#undef FP_SIMD_TARGET
+#endif // FP_SIMD_EVAL_X86
+
+#ifdef FP_SIMD_EVAL_NEON
+    FP_SIMD_KERNELS(neon, , 2, float64x2_t,
+                    vld1q_f64, vst1q_f64, vdupq_n_f64,
+                    vaddq_f64, vsubq_f64, vmulq_f64, vdivq_f64, vsqrtq_f64)
+
+    inline const BatchKernelTable& selectBatchKernels()
+    {
+        // Advanced SIMD is mandatory on AArch64
+        return neon::table();
+    }
+#endif // FP_SIMD_EVAL_NEON
+
+#undef FP_SIMD_KERNELS
+#undef FP_SIMD_LOOP
+
+    inline const BatchKernelTable& batchKernels()
+    {
+        static const BatchKernelTable& kernels = selectBatchKernels();
+        return kernels;
+    }
+
+    template<>
+    struct BatchKernels<double>
+    {
+        static void add(double* y, const double* x, unsigned n)
+        { batchKernels().add(y, x, n); }
+
+        static void sub(double* y, const double* x, unsigned n)
+        { batchKernels().sub(y, x, n); }
+
+        static void mul(double* y, const double* x, unsigned n)
+        { batchKernels().mul(y, x, n); }
+
+        static void div(double* y, const double* x, unsigned n)
+        { batchKernels().div(y, x, n); }
+
+        static void rsub(double* y, const double* x, unsigned n)
+        { batchKernels().rsub(y, x, n); }
+
+        static void rdiv(double* y, const double* x, unsigned n)
+        { batchKernels().rdiv(y, x, n); }
+
+        static void neg(double* x, unsigned n)
+        { batchKernels().neg(x, n); }
+
+        static void sqr(double* x, unsigned n)
+        { batchKernels().sqr(x, n); }
+
+        static void sqrt(double* x, unsigned n)
+        { batchKernels().sqrt(x, n); }
+
+        static void inv(double* x, unsigned n)
+        { batchKernels().inv(x, n); }
+
+        static void rsqrt(double* x, unsigned n)
+        { batchKernels().rsqrt(x, n); }
+    };
+#endif // FP_SIMD_EVAL_X86 || FP_SIMD_EVAL_NEON
+}
+#endif // ONCE_FPARSER_H_
+
+#endif
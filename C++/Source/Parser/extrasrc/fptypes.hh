@@ -20,7 +20,9 @@
 #include <cstring>
 
 #ifdef ONCE_FPARSER_H_
-#include <map>
+#include <vector>
+#include <utility>
+#include <algorithm>
 #endif
 
 namespace FUNCTIONPARSERTYPES
@@ -165,6 +167,7 @@ namespace FUNCTIONPARSERTYPES
         const char* name;
         unsigned nameLength;
 
+        NamePtr(): name(0), nameLength(0) {}
         NamePtr(const char* n, unsigned l): name(n), nameLength(l) {}
 
         inline bool operator==(const NamePtr& rhs) const
@@ -183,6 +186,15 @@ namespace FUNCTIONPARSERTYPES
             }
             return nameLength < rhs.nameLength;
         }
+
+        // FNV-1a
+        inline unsigned Hash() const
+        {
+            unsigned hash = 2166136261U;
+            for(unsigned i = 0; i < nameLength; ++i)
+                hash = (hash ^ static_cast<unsigned char>(name[i])) * 16777619U;
+            return hash;
+        }
     };
 
     template<typename Value_t>
@@ -198,11 +210,235 @@ namespace FUNCTIONPARSERTYPES
         NameData() { }
     };
 
+    /* The identifiers known by a parser: an open-addressed hash table
+       (linear probing over a power-of-two number of slots) whose names are
+       copied into a single arena of characters owned by the table. A lookup
+       costs a hash and usually a single comparison, however many constants
+       and functions have been added, and a copy costs two allocations.
+
+       erase() leaves a tombstone, so the iterators stay valid while the
+       entries are erased one by one; the tombstones and the characters of
+       the erased names are dropped when the slots or the arena grow. The
+       order of the iteration is unspecified.
+    */
     template<typename Value_t>
-    class NamePtrsMap: public
-    std::map<FUNCTIONPARSERTYPES::NamePtr,
-             FUNCTIONPARSERTYPES::NameData<Value_t> >
+    class NamePtrsMap
     {
+     public:
+        typedef std::pair<NamePtr, NameData<Value_t> > value_type;
+
+     private:
+        enum SlotState { EMPTY, USED, ERASED };
+
+        struct Slot
+        {
+            SlotState state;
+            unsigned hash;
+            value_type entry;
+
+            Slot(): state(EMPTY), hash(0) {}
+        };
+
+        template<typename Slot_t, typename Entry_t>
+        class Iterator
+        {
+         public:
+            Iterator(): mSlot(0), mEnd(0) {}
+            Iterator(Slot_t* slot, Slot_t* end): mSlot(slot), mEnd(end)
+            { SkipUnused(); }
+            template<typename S, typename E>
+            Iterator(const Iterator<S, E>& rhs):
+                mSlot(rhs.mSlot), mEnd(rhs.mEnd) {}
+
+            Entry_t& operator*() const { return mSlot->entry; }
+            Entry_t* operator->() const { return &mSlot->entry; }
+            Iterator& operator++() { ++mSlot; SkipUnused(); return *this; }
+            bool operator==(const Iterator& rhs) const
+            { return mSlot == rhs.mSlot; }
+            bool operator!=(const Iterator& rhs) const
+            { return mSlot != rhs.mSlot; }
+
+         private:
+            template<typename, typename> friend class Iterator;
+            friend class NamePtrsMap;
+
+            Slot_t* mSlot;
+            Slot_t* mEnd;
+
+            void SkipUnused()
+            {
+                while(mSlot != mEnd && mSlot->state != USED) ++mSlot;
+            }
+        };
+
+     public:
+        typedef Iterator<Slot, value_type> iterator;
+        typedef Iterator<const Slot, const value_type> const_iterator;
+
+        NamePtrsMap(): mUsed(0), mErased(0) {}
+
+        // The names of the copy point to its own arena
+        NamePtrsMap(const NamePtrsMap& rhs):
+            mSlots(rhs.mSlots), mNames(rhs.mNames),
+            mUsed(rhs.mUsed), mErased(rhs.mErased)
+        {
+            for(iterator i = begin(); i != end(); ++i)
+                i->first.name = mNames.data() + (i->first.name - rhs.mNames.data());
+        }
+
+        NamePtrsMap& operator=(const NamePtrsMap& rhs)
+        {
+            NamePtrsMap copy(rhs);
+            swap(copy);
+            return *this;
+        }
+
+        void swap(NamePtrsMap& rhs)
+        {
+            mSlots.swap(rhs.mSlots);
+            mNames.swap(rhs.mNames);
+            std::swap(mUsed, rhs.mUsed);
+            std::swap(mErased, rhs.mErased);
+        }
+
+        iterator begin() { return iterator(FirstSlot(), LastSlot()); }
+        iterator end() { return iterator(LastSlot(), LastSlot()); }
+        const_iterator begin() const
+        { return const_iterator(FirstSlot(), LastSlot()); }
+        const_iterator end() const
+        { return const_iterator(LastSlot(), LastSlot()); }
+
+        std::size_t size() const { return mUsed; }
+        bool empty() const { return mUsed == 0; }
+
+        iterator find(const NamePtr& name)
+        {
+            Slot* slot = Find(name, name.Hash());
+            return slot ? iterator(slot, LastSlot()) : end();
+        }
+
+        const_iterator find(const NamePtr& name) const
+        {
+            const Slot* slot = Find(name, name.Hash());
+            return slot ? const_iterator(slot, LastSlot()) : end();
+        }
+
+        // The name, which must not be in the table yet, is copied into the
+        // arena: the caller's one doesn't need to outlive the table.
+        iterator insert(const value_type& entry)
+        {
+            return Insert(entry, entry.first.Hash());
+        }
+
+        void erase(iterator position)
+        {
+            position.mSlot->state = ERASED;
+            position.mSlot->entry = value_type();
+            --mUsed;
+            ++mErased;
+        }
+
+
+     private:
+        std::vector<Slot> mSlots; // empty or a power of two
+        std::vector<char> mNames;
+        std::size_t mUsed, mErased;
+
+        Slot* FirstSlot() { return mSlots.empty() ? 0 : &mSlots[0]; }
+        Slot* LastSlot() { return FirstSlot() + mSlots.size(); }
+        const Slot* FirstSlot() const
+        { return mSlots.empty() ? 0 : &mSlots[0]; }
+        const Slot* LastSlot() const { return FirstSlot() + mSlots.size(); }
+
+        // At most half of the slots are used after a rehash
+        static std::size_t SlotCount(std::size_t entries)
+        {
+            std::size_t count = 16;
+            while(count < entries * 2) count *= 2;
+            return count;
+        }
+
+        std::size_t UsedCharacters() const
+        {
+            std::size_t characters = 0;
+            for(const_iterator i = begin(); i != end(); ++i)
+                characters += i->first.nameLength;
+            return characters;
+        }
+
+        Slot* Find(const NamePtr& name, unsigned hash) const
+        {
+            if(mSlots.empty()) return 0;
+            const std::size_t mask = mSlots.size() - 1;
+            for(std::size_t i = hash & mask; ; i = (i + 1) & mask)
+            {
+                const Slot& slot = mSlots[i];
+                if(slot.state == EMPTY) return 0;
+                if(slot.state == USED && slot.hash == hash &&
+                   slot.entry.first == name)
+                    return const_cast<Slot*>(&slot);
+            }
+        }
+
+        iterator Insert(const value_type& entry, unsigned hash)
+        {
+            // Some slots are always empty, so that Find() ends
+            if((mUsed + mErased + 1) * 4 > mSlots.size() * 3)
+                Rehash(SlotCount(mUsed + 1));
+            const char* name = StoreName(entry.first);
+
+            const std::size_t mask = mSlots.size() - 1;
+            std::size_t i = hash & mask;
+            while(mSlots[i].state == USED) i = (i + 1) & mask;
+            Slot& slot = mSlots[i];
+            if(slot.state == ERASED) --mErased;
+            slot.state = USED;
+            slot.hash = hash;
+            slot.entry = entry;
+            slot.entry.first.name = name;
+            ++mUsed;
+            return iterator(&slot, LastSlot());
+        }
+
+        void Rehash(std::size_t count)
+        {
+            std::vector<Slot> slots(count);
+            mSlots.swap(slots);
+            mErased = 0;
+            const std::size_t mask = count - 1;
+            for(std::size_t j = 0; j < slots.size(); ++j)
+            {
+                if(slots[j].state != USED) continue;
+                std::size_t i = slots[j].hash & mask;
+                while(mSlots[i].state == USED) i = (i + 1) & mask;
+                mSlots[i] = slots[j];
+            }
+        }
+
+        // When the arena is full it's replaced by a bigger one with only
+        // the names in use, and the entries are pointed to it.
+        const char* StoreName(const NamePtr& name)
+        {
+            if(mNames.size() + name.nameLength > mNames.capacity())
+            {
+                std::vector<char> names;
+                names.reserve(std::max(std::size_t(256), 2 * (UsedCharacters() +
+                                                              name.nameLength)));
+                for(std::size_t j = 0; j < mSlots.size(); ++j)
+                {
+                    if(mSlots[j].state != USED) continue;
+                    NamePtr& used = mSlots[j].entry.first;
+                    const std::size_t offset = names.size();
+                    names.insert(names.end(), used.name,
+                                 used.name + used.nameLength);
+                    used.name = names.data() + offset;
+                }
+                mNames.swap(names);
+            }
+            const std::size_t offset = mNames.size();
+            mNames.insert(mNames.end(), name.name, name.name + name.nameLength);
+            return mNames.data() + offset;
+        }
     };
 
     const unsigned FUNC_AMOUNT = sizeof(Functions)/sizeof(Functions[0]);
@@ -211,11 +447,14 @@ namespace FUNCTIONPARSERTYPES
 
 #ifdef ONCE_FPARSER_H_
 #include <vector>
+#include <atomic>
 
 template<typename Value_t>
 struct FunctionParserBase<Value_t>::Data
 {
-    unsigned mReferenceCounter;
+    // Atomic so that copies of a parser, which share this data, can be
+    // created and destroyed by different threads.
+    std::atomic<unsigned> mReferenceCounter;
 
     char mDelimiterChar;
     ParseErrorType mParseErrorType;
@@ -227,6 +466,12 @@ struct FunctionParserBase<Value_t>::Data
     unsigned mVariablesAmount;
     std::string mVariablesString;
     FUNCTIONPARSERTYPES::NamePtrsMap<Value_t> mNamePtrs;
+    // Where the names missing from mNamePtrs are looked up
+    SymbolTable mSymbolTable;
+    // The functions of mSymbolTable used so far. They are kept apart from
+    // mNamePtrs, so that the variables and the functions of the parser
+    // can still take their names, and shadow them.
+    FUNCTIONPARSERTYPES::NamePtrsMap<Value_t> mImportedNames;
 
     struct InlineVariable
     {
@@ -270,6 +515,8 @@ struct FunctionParserBase<Value_t>::Data
     std::vector<Value_t> mStack;
     // Note: When mStack exists,
     //       mStack.size() and mStackSize are mutually redundant.
+    std::vector<Value_t> mBatchStack;
+    // Note: mBatchStack is allocated on the first call to EvalBatch().
 #endif
 
     unsigned mStackSize;
@@ -277,7 +524,6 @@ struct FunctionParserBase<Value_t>::Data
     Data();
     Data(const Data&);
     Data& operator=(const Data&); // not implemented on purpose
-    ~Data();
 };
 #endif
 
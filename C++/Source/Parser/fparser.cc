@@ -18,9 +18,11 @@
 #include <cmath>
 #include <cassert>
 #include <limits>
+#include <sstream>
 
 #include "extrasrc/fptypes.hh"
 #include "extrasrc/fpaux.hh"
+#include "extrasrc/fpsimd.hh"
 using namespace FUNCTIONPARSERTYPES;
 
 #ifdef FP_USE_THREAD_SAFE_EVAL_WITH_ALLOCA
@@ -671,13 +673,13 @@ namespace
     // Return value will be false if the name already existed
     template<typename Value_t>
     bool addNewNameData(NamePtrsMap<Value_t>& namePtrs,
-                        std::pair<NamePtr, NameData<Value_t> >& newName,
+                        const std::pair<NamePtr, NameData<Value_t> >& newName,
                         bool isVar)
     {
         typename NamePtrsMap<Value_t>::iterator nameIter =
-            namePtrs.lower_bound(newName.first);
+            namePtrs.find(newName.first);
 
-        if(nameIter != namePtrs.end() && newName.first == nameIter->first)
+        if(nameIter != namePtrs.end())
         {
             // redefining a var is not allowed.
             if(isVar) return false;
@@ -691,17 +693,8 @@ namespace
             return true;
         }
 
-        if(!isVar)
-        {
-            // Allocate a copy of the name (pointer stored in the map key)
-            // However, for VARIABLEs, the pointer points to VariableString,
-            // which is managed separately. Thusly, only done when !IsVar.
-            char* namebuf = new char[newName.first.nameLength];
-            memcpy(namebuf, newName.first.name, newName.first.nameLength);
-            newName.first.name = namebuf;
-        }
-
-        namePtrs.insert(nameIter, newName);
+        // The map keeps its own copy of the name
+        namePtrs.insert(newName);
         return true;
     }
 }
@@ -732,7 +725,9 @@ FunctionParserBase<Value_t>::Data::Data(const Data& rhs):
     mErrorLocation(rhs.mErrorLocation),
     mVariablesAmount(rhs.mVariablesAmount),
     mVariablesString(rhs.mVariablesString),
-    mNamePtrs(),
+    mNamePtrs(rhs.mNamePtrs),
+    mSymbolTable(rhs.mSymbolTable),
+    mImportedNames(rhs.mImportedNames),
     mFuncPtrs(rhs.mFuncPtrs),
     mFuncParsers(rhs.mFuncParsers),
     mByteCode(rhs.mByteCode),
@@ -741,44 +736,7 @@ FunctionParserBase<Value_t>::Data::Data(const Data& rhs):
     mStack(rhs.mStackSize),
 #endif
     mStackSize(rhs.mStackSize)
-{
-    for(typename NamePtrsMap<Value_t>::const_iterator i = rhs.mNamePtrs.begin();
-        i != rhs.mNamePtrs.end();
-        ++i)
-    {
-        if(i->second.type == NameData<Value_t>::VARIABLE)
-        {
-            const std::size_t variableStringOffset =
-                i->first.name - rhs.mVariablesString.c_str();
-            std::pair<NamePtr, NameData<Value_t> > tmp
-                (NamePtr(&mVariablesString[variableStringOffset],
-                         i->first.nameLength),
-                 i->second);
-            mNamePtrs.insert(mNamePtrs.end(), tmp);
-        }
-        else
-        {
-            std::pair<NamePtr, NameData<Value_t> > tmp
-                (NamePtr(new char[i->first.nameLength], i->first.nameLength),
-                 i->second );
-            memcpy(const_cast<char*>(tmp.first.name), i->first.name,
-                   tmp.first.nameLength);
-            mNamePtrs.insert(mNamePtrs.end(), tmp);
-        }
-    }
-}
-
-template<typename Value_t>
-FunctionParserBase<Value_t>::Data::~Data()
-{
-    for(typename NamePtrsMap<Value_t>::iterator i = mNamePtrs.begin();
-        i != mNamePtrs.end();
-        ++i)
-    {
-        if(i->second.type != NameData<Value_t>::VARIABLE)
-            delete[] i->first.name;
-    }
-}
+{}
 
 template<typename Value_t>
 void FunctionParserBase<Value_t>::incFuncWrapperRefCount
@@ -913,6 +871,51 @@ void FunctionParserBase<Value_t>::ForceDeepCopy()
 }
 
 
+//=========================================================================
+// Symbol tables
+//=========================================================================
+template<typename Value_t>
+FunctionParserBase<Value_t>::SymbolTable::SymbolTable():
+    mData(0)
+{}
+
+template<typename Value_t>
+FunctionParserBase<Value_t>::SymbolTable::SymbolTable
+(const FunctionParserBase& Symbols):
+    mData(Symbols.mData)
+{
+    ++(mData->mReferenceCounter);
+}
+
+template<typename Value_t>
+FunctionParserBase<Value_t>::SymbolTable::SymbolTable(const SymbolTable& cpy):
+    mData(cpy.mData)
+{
+    if(mData) ++(mData->mReferenceCounter);
+}
+
+template<typename Value_t>
+typename FunctionParserBase<Value_t>::SymbolTable&
+FunctionParserBase<Value_t>::SymbolTable::operator=(const SymbolTable& cpy)
+{
+    if(mData != cpy.mData)
+    {
+        if(mData && --(mData->mReferenceCounter) == 0) delete mData;
+
+        mData = cpy.mData;
+        if(mData) ++(mData->mReferenceCounter);
+    }
+    return *this;
+}
+
+template<typename Value_t>
+FunctionParserBase<Value_t>::SymbolTable::~SymbolTable()
+{
+    if(mData && --(mData->mReferenceCounter) == 0)
+        delete mData;
+}
+
+
 //=========================================================================
 // Epsilon
 //=========================================================================
@@ -995,16 +998,11 @@ typename FunctionParserBase<Value_t>::FunctionWrapper*
 FunctionParserBase<Value_t>::GetFunctionWrapper(const std::string& name)
 {
     CopyOnWrite();
-    NamePtr namePtr(name.data(), unsigned(name.size()));
+    const NameData<Value_t>* nameData =
+        FindName(NamePtr(name.data(), unsigned(name.size())));
 
-    typename NamePtrsMap<Value_t>::iterator nameIter =
-        mData->mNamePtrs.find(namePtr);
-
-    if(nameIter != mData->mNamePtrs.end() &&
-       nameIter->second.type == NameData<Value_t>::FUNC_PTR)
-    {
-        return mData->mFuncPtrs[nameIter->second.index].mFuncWrapperPtr;
-    }
+    if(nameData && nameData->type == NameData<Value_t>::FUNC_PTR)
+        return mData->mFuncPtrs[nameData->index].mFuncWrapperPtr;
     return 0;
 }
 
@@ -1060,13 +1058,78 @@ bool FunctionParserBase<Value_t>::RemoveIdentifier(const std::string& name)
             // Illegal attempt to delete variables
             return false;
         }
-        delete[] nameIter->first.name;
         mData->mNamePtrs.erase(nameIter);
         return true;
     }
     return false;
 }
 
+template<typename Value_t>
+void FunctionParserBase<Value_t>::UseSymbolTable(const SymbolTable& Table)
+{
+    CopyOnWrite();
+    mData->mSymbolTable = Table;
+    // The functions imported from the old table are still called by the
+    // current bytecode, but the next Parse() looks them up in the new one
+    NamePtrsMap<Value_t>().swap(mData->mImportedNames);
+}
+
+// Looks the name up in the parser, then in its symbol table (and in the
+// tables that one is layered on). The constants and units are read from the
+// table, but a function is imported when it's first used: the bytecode
+// refers to it by its index in mFuncPtrs or mFuncParsers, so it's copied
+// there and its name is added to mImportedNames. A function parser that
+// would call this one isn't imported, and *recursive is set to true.
+template<typename Value_t>
+const NameData<Value_t>*
+FunctionParserBase<Value_t>::FindName(const NamePtr& name, bool* recursive)
+{
+    typename NamePtrsMap<Value_t>::iterator nameIter =
+        mData->mNamePtrs.find(name);
+    if(nameIter != mData->mNamePtrs.end()) return &nameIter->second;
+    nameIter = mData->mImportedNames.find(name);
+    if(nameIter != mData->mImportedNames.end()) return &nameIter->second;
+
+    for(const Data* table = mData->mSymbolTable.mData; table;
+        table = table->mSymbolTable.mData)
+    {
+        typename NamePtrsMap<Value_t>::const_iterator found =
+            table->mNamePtrs.find(name);
+        if(found == table->mNamePtrs.end()) continue;
+
+        std::pair<NamePtr, NameData<Value_t> > newName(name, found->second);
+        switch(found->second.type)
+        {
+          case NameData<Value_t>::CONSTANT:
+          case NameData<Value_t>::UNIT:
+              return &found->second;
+
+          case NameData<Value_t>::FUNC_PTR:
+              newName.second.index = unsigned(mData->mFuncPtrs.size());
+              mData->mFuncPtrs.push_back
+                  (table->mFuncPtrs[found->second.index]);
+              break;
+
+          case NameData<Value_t>::PARSER_PTR:
+              if(CheckRecursiveLinking
+                 (table->mFuncParsers[found->second.index].mParserPtr))
+              {
+                  if(recursive) *recursive = true;
+                  return 0;
+              }
+              newName.second.index = unsigned(mData->mFuncParsers.size());
+              mData->mFuncParsers.push_back
+                  (table->mFuncParsers[found->second.index]);
+              break;
+
+          case NameData<Value_t>::VARIABLE: // of the parser the table was
+              continue;                     // made of
+        }
+        return &mData->mImportedNames.insert(newName)->second;
+    }
+    return 0;
+}
+
 
 //=========================================================================
 // Function parsing
@@ -1090,6 +1153,8 @@ namespace
         "Syntax error: Premature end of string",    // 9
         "Syntax error: Expecting ( after function", // 10
         "Syntax error: Unknown identifier",         // 11
+        "Recursive call: the function calls "
+        "this parser",                              // 12
         "(No function has been parsed yet)",
         ""
     };
@@ -1927,9 +1992,9 @@ const char* FunctionParserBase<Value_t>::CompileElement(const char* function)
     const char* endPtr = function + nameLength;
     SkipSpace(endPtr);
 
-    typename NamePtrsMap<Value_t>::iterator nameIter =
-        mData->mNamePtrs.find(name);
-    if(nameIter == mData->mNamePtrs.end())
+    bool recursive = false;
+    const NameData<Value_t>* nameData = FindName(name, &recursive);
+    if(!nameData)
     {
         // Check if it's an inline variable:
         for(typename Data::InlineVarNamesContainer::reverse_iterator iter =
@@ -1953,10 +2018,10 @@ const char* FunctionParserBase<Value_t>::CompileElement(const char* function)
             }
         }
 
-        return SetErrorType(UNKNOWN_IDENTIFIER, function);
+        return SetErrorType(recursive ? RECURSIVE_CALL : UNKNOWN_IDENTIFIER,
+                            function);
     }
 
-    const NameData<Value_t>* nameData = &nameIter->second;
     switch(nameData->type)
     {
       case NameData<Value_t>::VARIABLE: // is variable
@@ -2057,22 +2122,17 @@ FunctionParserBase<Value_t>::CompilePossibleUnit(const char* function)
     {
         NamePtr name(function, nameLength);
 
-        typename NamePtrsMap<Value_t>::iterator nameIter =
-            mData->mNamePtrs.find(name);
-        if(nameIter != mData->mNamePtrs.end())
+        const NameData<Value_t>* nameData = FindName(name);
+        if(nameData && nameData->type == NameData<Value_t>::UNIT)
         {
-            const NameData<Value_t>* nameData = &nameIter->second;
-            if(nameData->type == NameData<Value_t>::UNIT)
-            {
-                AddImmedOpcode(nameData->value);
-                incStackPtr();
-                AddFunctionOpcode(cMul);
-                --mStackPtr;
+            AddImmedOpcode(nameData->value);
+            incStackPtr();
+            AddFunctionOpcode(cMul);
+            --mStackPtr;
 
-                const char* endPtr = function + nameLength;
-                SkipSpace(endPtr);
-                return endPtr;
-            }
+            const char* endPtr = function + nameLength;
+            SkipSpace(endPtr);
+            return endPtr;
         }
     }
 
@@ -2535,9 +2595,7 @@ const char* FunctionParserBase<Value_t>::Compile(const char* function)
                 { NamePtr(function, nameLength), 0 };
 
             // Check if it's an unknown identifier:
-            typename NamePtrsMap<Value_t>::iterator nameIter =
-                mData->mNamePtrs.find(inlineVar.mName);
-            if(nameIter == mData->mNamePtrs.end())
+            if(!FindName(inlineVar.mName))
             {
                 const char* function2 = function + nameLength;
                 SkipSpace(function2);
@@ -2590,12 +2648,6 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
 {
     if(mData->mParseErrorType != FP_NO_ERROR) return Value_t(0);
 
-    const unsigned* const byteCode = &(mData->mByteCode[0]);
-    const Value_t* const immed = mData->mImmed.empty() ? 0 : &(mData->mImmed[0]);
-    const unsigned byteCodeSize = unsigned(mData->mByteCode.size());
-    unsigned IP, DP=0;
-    int SP=-1;
-
 #ifdef FP_USE_THREAD_SAFE_EVAL
     /* If Eval() may be called by multiple threads simultaneously,
      * then Eval() must allocate its own stack.
@@ -2618,9 +2670,41 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
 #endif
 #else
     /* No thread safety, so use a global stack. */
-    std::vector<Value_t>& Stack = mData->mStack;
+    Value_t* const Stack = &mData->mStack[0];
 #endif
 
+    return EvalWithStack(Vars, Stack, 0, mData->mEvalErrorType);
+}
+
+template<typename Value_t>
+Value_t FunctionParserBase<Value_t>::Eval(EvalContext& context,
+                                          const Value_t* Vars) const
+{
+    if(mData->mParseErrorType != FP_NO_ERROR) return Value_t(0);
+
+    if(context.mStack.size() < mData->mStackSize)
+        context.mStack.resize(mData->mStackSize);
+
+    return EvalWithStack(Vars, &context.mStack[0], &context,
+                         context.mEvalErrorType);
+}
+
+/* The interpreter shared by all the Eval() functions. It only reads mData:
+   the stack and the error code are supplied by the caller, and so is the
+   context used for nested parsers (0 when called from the Eval() which
+   uses the state stored in the parsers themselves).
+ */
+template<typename Value_t>
+Value_t FunctionParserBase<Value_t>::EvalWithStack
+(const Value_t* Vars, Value_t* Stack, EvalContext* context,
+ int& evalError) const
+{
+    const unsigned* const byteCode = &(mData->mByteCode[0]);
+    const Value_t* const immed = mData->mImmed.empty() ? 0 : &(mData->mImmed[0]);
+    const unsigned byteCodeSize = unsigned(mData->mByteCode.size());
+    unsigned IP, DP=0;
+    int SP=-1;
+
     for(IP=0; IP<byteCodeSize; ++IP)
     {
         switch(byteCode[IP])
@@ -2631,19 +2715,19 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
           case  cAcos:
               if(IsComplexType<Value_t>::result == false
               && (Stack[SP] < Value_t(-1) || Stack[SP] > Value_t(1)))
-              { mData->mEvalErrorType=4; return Value_t(0); }
+              { evalError=4; return Value_t(0); }
               Stack[SP] = fp_acos(Stack[SP]); break;
 
           case cAcosh:
               if(IsComplexType<Value_t>::result == false
               && Stack[SP] < Value_t(1))
-              { mData->mEvalErrorType=4; return Value_t(0); }
+              { evalError=4; return Value_t(0); }
               Stack[SP] = fp_acosh(Stack[SP]); break;
 
           case  cAsin:
               if(IsComplexType<Value_t>::result == false
               && (Stack[SP] < Value_t(-1) || Stack[SP] > Value_t(1)))
-              { mData->mEvalErrorType=4; return Value_t(0); }
+              { evalError=4; return Value_t(0); }
               Stack[SP] = fp_asin(Stack[SP]); break;
 
           case cAsinh: Stack[SP] = fp_asinh(Stack[SP]); break;
@@ -2657,7 +2741,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               if(IsComplexType<Value_t>::result
               ?  (Stack[SP] == Value_t(-1) || Stack[SP] == Value_t(1))
               :  (Stack[SP] <= Value_t(-1) || Stack[SP] >= Value_t(1)))
-              { mData->mEvalErrorType=4; return Value_t(0); }
+              { evalError=4; return Value_t(0); }
               Stack[SP] = fp_atanh(Stack[SP]); break;
 
           case  cCbrt: Stack[SP] = fp_cbrt(Stack[SP]); break;
@@ -2672,7 +2756,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               {
                   const Value_t t = fp_tan(Stack[SP]);
                   if(t == Value_t(0))
-                  { mData->mEvalErrorType=1; return Value_t(0); }
+                  { evalError=1; return Value_t(0); }
                   Stack[SP] = Value_t(1)/t; break;
               }
 
@@ -2680,7 +2764,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               {
                   const Value_t s = fp_sin(Stack[SP]);
                   if(s == Value_t(0))
-                  { mData->mEvalErrorType=1; return Value_t(0); }
+                  { evalError=1; return Value_t(0); }
                   Stack[SP] = Value_t(1)/s; break;
               }
 
@@ -2712,14 +2796,14 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               if(IsComplexType<Value_t>::result
                ?   Stack[SP] == Value_t(0)
                :   !(Stack[SP] > Value_t(0)))
-              { mData->mEvalErrorType=3; return Value_t(0); }
+              { evalError=3; return Value_t(0); }
               Stack[SP] = fp_log(Stack[SP]); break;
 
           case cLog10:
               if(IsComplexType<Value_t>::result
                ?   Stack[SP] == Value_t(0)
                :   !(Stack[SP] > Value_t(0)))
-              { mData->mEvalErrorType=3; return Value_t(0); }
+              { evalError=3; return Value_t(0); }
               Stack[SP] = fp_log10(Stack[SP]);
               break;
 
@@ -2727,7 +2811,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               if(IsComplexType<Value_t>::result
                ?   Stack[SP] == Value_t(0)
                :   !(Stack[SP] > Value_t(0)))
-              { mData->mEvalErrorType=3; return Value_t(0); }
+              { evalError=3; return Value_t(0); }
               Stack[SP] = fp_log2(Stack[SP]);
               break;
 
@@ -2748,7 +2832,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               // x:0 ^ y:negative is failure
               if(Stack[SP-1] == Value_t(0) &&
                  Stack[SP] < Value_t(0))
-              { mData->mEvalErrorType=3; return Value_t(0); }
+              { evalError=3; return Value_t(0); }
               Stack[SP-1] = fp_pow(Stack[SP-1], Stack[SP]);
               --SP; break;
 
@@ -2758,7 +2842,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               {
                   const Value_t c = fp_cos(Stack[SP]);
                   if(c == Value_t(0))
-                  { mData->mEvalErrorType=1; return Value_t(0); }
+                  { evalError=1; return Value_t(0); }
                   Stack[SP] = Value_t(1)/c; break;
               }
 
@@ -2769,7 +2853,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
           case  cSqrt:
               if(IsComplexType<Value_t>::result == false &&
                  Stack[SP] < Value_t(0))
-              { mData->mEvalErrorType=2; return Value_t(0); }
+              { evalError=2; return Value_t(0); }
               Stack[SP] = fp_sqrt(Stack[SP]); break;
 
           case   cTan: Stack[SP] = fp_tan(Stack[SP]); break;
@@ -2796,12 +2880,12 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
 
           case   cDiv:
               if(Stack[SP] == Value_t(0))
-              { mData->mEvalErrorType=1; return Value_t(0); }
+              { evalError=1; return Value_t(0); }
               Stack[SP-1] /= Stack[SP]; --SP; break;
 
           case   cMod:
               if(Stack[SP] == Value_t(0))
-              { mData->mEvalErrorType=1; return Value_t(0); }
+              { evalError=1; return Value_t(0); }
               Stack[SP-1] = fp_mod(Stack[SP-1], Stack[SP]);
               --SP; break;
 
@@ -2864,16 +2948,26 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               {
                   unsigned index = byteCode[++IP];
                   unsigned params = mData->mFuncParsers[index].mParams;
-                  Value_t retVal =
-                      mData->mFuncParsers[index].mParserPtr->Eval
-                      (&Stack[SP-params+1]);
+                  FunctionParserBase<Value_t>* const parser =
+                      mData->mFuncParsers[index].mParserPtr;
+                  Value_t retVal;
+                  int error;
+                  if(context)
+                  {
+                      EvalContext& nested = context->NestedContext(index);
+                      retVal = parser->Eval(nested, &Stack[SP-params+1]);
+                      error = nested.EvalError();
+                  }
+                  else
+                  {
+                      retVal = parser->Eval(&Stack[SP-params+1]);
+                      error = parser->EvalError();
+                  }
                   SP -= int(params)-1;
                   Stack[SP] = retVal;
-                  const int error =
-                      mData->mFuncParsers[index].mParserPtr->EvalError();
                   if(error)
                   {
-                      mData->mEvalErrorType = error;
+                      evalError = error;
                       return 0;
                   }
                   break;
@@ -2901,7 +2995,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
               if(IsComplexType<Value_t>::result
                ?   Stack[SP-1] == Value_t(0)
                :   !(Stack[SP-1] > Value_t(0)))
-              { mData->mEvalErrorType=3; return Value_t(0); }
+              { evalError=3; return Value_t(0); }
               Stack[SP-1] = fp_log2(Stack[SP-1]) * Stack[SP];
               --SP;
               break;
@@ -2943,7 +3037,7 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
 
           case   cInv:
               if(Stack[SP] == Value_t(0))
-              { mData->mEvalErrorType=1; return Value_t(0); }
+              { evalError=1; return Value_t(0); }
               Stack[SP] = Value_t(1)/Stack[SP];
               break;
 
@@ -2953,14 +3047,14 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
 
           case   cRDiv:
               if(Stack[SP-1] == Value_t(0))
-              { mData->mEvalErrorType=1; return Value_t(0); }
+              { evalError=1; return Value_t(0); }
               Stack[SP-1] = Stack[SP] / Stack[SP-1]; --SP; break;
 
           case   cRSub: Stack[SP-1] = Stack[SP] - Stack[SP-1]; --SP; break;
 
           case   cRSqrt:
               if(Stack[SP] == Value_t(0))
-              { mData->mEvalErrorType=1; return Value_t(0); }
+              { evalError=1; return Value_t(0); }
               Stack[SP] = Value_t(1) / fp_sqrt(Stack[SP]); break;
 
 #ifdef FP_SUPPORT_COMPLEX_NUMBERS
@@ -2980,11 +3074,1884 @@ Value_t FunctionParserBase<Value_t>::Eval(const Value_t* Vars)
         }
     }
 
-    mData->mEvalErrorType=0;
+    evalError=0;
     return Stack[SP];
 }
 
 
+//===========================================================================
+// Evaluation with derivative
+//===========================================================================
+template<typename Value_t>
+Value_t FunctionParserBase<Value_t>::EvalWithDerivative
+(EvalContext& context, const Value_t* Vars, unsigned VarIndex,
+ Value_t& Derivative) const
+{
+    Derivative = Value_t(0);
+    if(mData->mParseErrorType != FP_NO_ERROR) return Value_t(0);
+
+    if(context.mStack.size() < mData->mStackSize)
+        context.mStack.resize(mData->mStackSize);
+    if(context.mDerivativeStack.size() < mData->mStackSize)
+        context.mDerivativeStack.resize(mData->mStackSize);
+
+    std::vector<Value_t>& seeds = context.mDerivativeSeeds;
+    seeds.assign(mData->mVariablesAmount, Value_t(0));
+    if(VarIndex < mData->mVariablesAmount) seeds[VarIndex] = Value_t(1);
+
+    return EvalDualWithStack(Vars, seeds.data(), &context.mStack[0],
+                             &context.mDerivativeStack[0], context,
+                             context.mEvalErrorType, Derivative);
+}
+
+template<typename Value_t>
+Value_t FunctionParserBase<Value_t>::EvalWithDirectionalDerivative
+(EvalContext& context, const Value_t* Vars, const Value_t* Direction,
+ Value_t& Derivative) const
+{
+    Derivative = Value_t(0);
+    if(mData->mParseErrorType != FP_NO_ERROR) return Value_t(0);
+
+    if(context.mStack.size() < mData->mStackSize)
+        context.mStack.resize(mData->mStackSize);
+    if(context.mDerivativeStack.size() < mData->mStackSize)
+        context.mDerivativeStack.resize(mData->mStackSize);
+
+    std::vector<Value_t>& seeds = context.mDerivativeSeeds;
+    seeds.assign(Direction, Direction + mData->mVariablesAmount);
+
+    return EvalDualWithStack(Vars, seeds.data(), &context.mStack[0],
+                             &context.mDerivativeStack[0], context,
+                             context.mEvalErrorType, Derivative);
+}
+
+/* Same as EvalWithStack(), but every value of Stack comes with its
+   derivative in the same position of Deriv. VarDerivs holds the derivatives
+   of the variables, which are the seeds of the forward-mode differentiation
+   (or the derivatives of the parameters when this is a nested parser).
+ */
+template<typename Value_t>
+Value_t FunctionParserBase<Value_t>::EvalDualWithStack
+(const Value_t* Vars, const Value_t* VarDerivs, Value_t* Stack,
+ Value_t* Deriv, EvalContext& context, int& evalError,
+ Value_t& derivative) const
+{
+    const unsigned* const byteCode = &(mData->mByteCode[0]);
+    const Value_t* const immed = mData->mImmed.empty() ? 0 : &(mData->mImmed[0]);
+    const unsigned byteCodeSize = unsigned(mData->mByteCode.size());
+    unsigned IP, DP=0;
+    int SP=-1;
+
+    for(IP=0; IP<byteCodeSize; ++IP)
+    {
+        switch(byteCode[IP])
+        {
+// Functions:
+          case   cAbs:
+              if(Stack[SP] < Value_t(0)) Deriv[SP] = -Deriv[SP];
+              Stack[SP] = fp_abs(Stack[SP]); break;
+
+          case  cAcos:
+              if(IsComplexType<Value_t>::result == false
+              && (Stack[SP] < Value_t(-1) || Stack[SP] > Value_t(1)))
+              { evalError=4; return Value_t(0); }
+              Deriv[SP] = -Deriv[SP] / fp_sqrt(Value_t(1) - Stack[SP]*Stack[SP]);
+              Stack[SP] = fp_acos(Stack[SP]); break;
+
+          case cAcosh:
+              if(IsComplexType<Value_t>::result == false
+              && Stack[SP] < Value_t(1))
+              { evalError=4; return Value_t(0); }
+              Deriv[SP] /= fp_sqrt(Stack[SP]*Stack[SP] - Value_t(1));
+              Stack[SP] = fp_acosh(Stack[SP]); break;
+
+          case  cAsin:
+              if(IsComplexType<Value_t>::result == false
+              && (Stack[SP] < Value_t(-1) || Stack[SP] > Value_t(1)))
+              { evalError=4; return Value_t(0); }
+              Deriv[SP] /= fp_sqrt(Value_t(1) - Stack[SP]*Stack[SP]);
+              Stack[SP] = fp_asin(Stack[SP]); break;
+
+          case cAsinh:
+              Deriv[SP] /= fp_sqrt(Stack[SP]*Stack[SP] + Value_t(1));
+              Stack[SP] = fp_asinh(Stack[SP]); break;
+
+          case  cAtan:
+              Deriv[SP] /= Value_t(1) + Stack[SP]*Stack[SP];
+              Stack[SP] = fp_atan(Stack[SP]); break;
+
+          case cAtan2:
+              Deriv[SP-1] = (Stack[SP]*Deriv[SP-1] - Stack[SP-1]*Deriv[SP])
+                  / (Stack[SP-1]*Stack[SP-1] + Stack[SP]*Stack[SP]);
+              Stack[SP-1] = fp_atan2(Stack[SP-1], Stack[SP]);
+              --SP; break;
+
+          case cAtanh:
+              if(IsComplexType<Value_t>::result
+              ?  (Stack[SP] == Value_t(-1) || Stack[SP] == Value_t(1))
+              :  (Stack[SP] <= Value_t(-1) || Stack[SP] >= Value_t(1)))
+              { evalError=4; return Value_t(0); }
+              Deriv[SP] /= Value_t(1) - Stack[SP]*Stack[SP];
+              Stack[SP] = fp_atanh(Stack[SP]); break;
+
+          case  cCbrt:
+              Stack[SP] = fp_cbrt(Stack[SP]);
+              Deriv[SP] /= Value_t(3) * Stack[SP]*Stack[SP]; break;
+
+          case  cCeil: Stack[SP] = fp_ceil(Stack[SP]);
+                       Deriv[SP] = Value_t(0); break;
+
+          case   cCos:
+              Deriv[SP] *= -fp_sin(Stack[SP]);
+              Stack[SP] = fp_cos(Stack[SP]); break;
+
+          case  cCosh:
+              Deriv[SP] *= fp_sinh(Stack[SP]);
+              Stack[SP] = fp_cosh(Stack[SP]); break;
+
+          case   cCot:
+              {
+                  const Value_t t = fp_tan(Stack[SP]);
+                  if(t == Value_t(0))
+                  { evalError=1; return Value_t(0); }
+                  Stack[SP] = Value_t(1)/t;
+                  Deriv[SP] *= -(Value_t(1) + Stack[SP]*Stack[SP]); break;
+              }
+
+          case   cCsc:
+              {
+                  const Value_t s = fp_sin(Stack[SP]);
+                  if(s == Value_t(0))
+                  { evalError=1; return Value_t(0); }
+                  Deriv[SP] *= -fp_cos(Stack[SP]) / (s*s);
+                  Stack[SP] = Value_t(1)/s; break;
+              }
+
+
+          case   cExp: Stack[SP] = fp_exp(Stack[SP]);
+                       Deriv[SP] *= Stack[SP]; break;
+
+          case   cExp2: Stack[SP] = fp_exp2(Stack[SP]);
+                        Deriv[SP] *= Stack[SP] * fp_const_log2<Value_t>();
+                        break;
+
+          case cFloor: Stack[SP] = fp_floor(Stack[SP]);
+                       Deriv[SP] = Value_t(0); break;
+
+          case cHypot:
+              {
+                  const Value_t h = fp_hypot(Stack[SP-1], Stack[SP]);
+                  Deriv[SP-1] = (Stack[SP-1]*Deriv[SP-1]
+                                 + Stack[SP]*Deriv[SP]) / h;
+                  Stack[SP-1] = h;
+                  --SP; break;
+              }
+
+          case    cIf:
+                  if(fp_truth(Stack[SP--]))
+                      IP += 2;
+                  else
+                  {
+                      const unsigned* buf = &byteCode[IP+1];
+                      IP = buf[0];
+                      DP = buf[1];
+                  }
+                  break;
+
+          case   cInt: Stack[SP] = fp_int(Stack[SP]);
+                       Deriv[SP] = Value_t(0); break;
+
+          case   cLog:
+              if(IsComplexType<Value_t>::result
+               ?   Stack[SP] == Value_t(0)
+               :   !(Stack[SP] > Value_t(0)))
+              { evalError=3; return Value_t(0); }
+              Deriv[SP] /= Stack[SP];
+              Stack[SP] = fp_log(Stack[SP]); break;
+
+          case cLog10:
+              if(IsComplexType<Value_t>::result
+               ?   Stack[SP] == Value_t(0)
+               :   !(Stack[SP] > Value_t(0)))
+              { evalError=3; return Value_t(0); }
+              Deriv[SP] /= Stack[SP] * fp_const_log10<Value_t>();
+              Stack[SP] = fp_log10(Stack[SP]);
+              break;
+
+          case  cLog2:
+              if(IsComplexType<Value_t>::result
+               ?   Stack[SP] == Value_t(0)
+               :   !(Stack[SP] > Value_t(0)))
+              { evalError=3; return Value_t(0); }
+              Deriv[SP] /= Stack[SP] * fp_const_log2<Value_t>();
+              Stack[SP] = fp_log2(Stack[SP]);
+              break;
+
+          case   cMax:
+              if(Stack[SP-1] < Stack[SP]) Deriv[SP-1] = Deriv[SP];
+              Stack[SP-1] = fp_max(Stack[SP-1], Stack[SP]);
+              --SP; break;
+
+          case   cMin:
+              if(Stack[SP] < Stack[SP-1]) Deriv[SP-1] = Deriv[SP];
+              Stack[SP-1] = fp_min(Stack[SP-1], Stack[SP]);
+              --SP; break;
+
+          case   cPow:
+              if(Stack[SP-1] == Value_t(0) &&
+                 Stack[SP] < Value_t(0))
+              { evalError=3; return Value_t(0); }
+              {
+                  // The terms are skipped when their derivative is zero, so
+                  // that a constant exponent does not need the log of the
+                  // base (which can be negative) and vice versa.
+                  const Value_t base = Stack[SP-1], exponent = Stack[SP];
+                  const Value_t result = fp_pow(base, exponent);
+                  Value_t d = Value_t(0);
+                  if(Deriv[SP-1] != Value_t(0))
+                      d += exponent * fp_pow(base, exponent - Value_t(1))
+                           * Deriv[SP-1];
+                  if(Deriv[SP] != Value_t(0))
+                      d += result * fp_log(base) * Deriv[SP];
+                  Stack[SP-1] = result;
+                  Deriv[SP-1] = d;
+              }
+              --SP; break;
+
+          case  cTrunc: Stack[SP] = fp_trunc(Stack[SP]);
+                        Deriv[SP] = Value_t(0); break;
+
+          case   cSec:
+              {
+                  const Value_t c = fp_cos(Stack[SP]);
+                  if(c == Value_t(0))
+                  { evalError=1; return Value_t(0); }
+                  Deriv[SP] *= fp_sin(Stack[SP]) / (c*c);
+                  Stack[SP] = Value_t(1)/c; break;
+              }
+
+          case   cSin:
+              Deriv[SP] *= fp_cos(Stack[SP]);
+              Stack[SP] = fp_sin(Stack[SP]); break;
+
+          case  cSinh:
+              Deriv[SP] *= fp_cosh(Stack[SP]);
+              Stack[SP] = fp_sinh(Stack[SP]); break;
+
+          case  cSqrt:
+              if(IsComplexType<Value_t>::result == false &&
+                 Stack[SP] < Value_t(0))
+              { evalError=2; return Value_t(0); }
+              Stack[SP] = fp_sqrt(Stack[SP]);
+              Deriv[SP] /= Value_t(2) * Stack[SP]; break;
+
+          case   cTan:
+              Stack[SP] = fp_tan(Stack[SP]);
+              Deriv[SP] *= Value_t(1) + Stack[SP]*Stack[SP]; break;
+
+          case  cTanh:
+              Stack[SP] = fp_tanh(Stack[SP]);
+              Deriv[SP] *= Value_t(1) - Stack[SP]*Stack[SP]; break;
+
+
+// Misc:
+          case cImmed: Stack[++SP] = immed[DP++];
+                       Deriv[SP] = Value_t(0); break;
+
+          case  cJump:
+              {
+                  const unsigned* buf = &byteCode[IP+1];
+                  IP = buf[0];
+                  DP = buf[1];
+                  break;
+              }
+
+// Operators:
+          case   cNeg: Stack[SP] = -Stack[SP]; Deriv[SP] = -Deriv[SP]; break;
+          case   cAdd: Stack[SP-1] += Stack[SP]; Deriv[SP-1] += Deriv[SP];
+                       --SP; break;
+          case   cSub: Stack[SP-1] -= Stack[SP]; Deriv[SP-1] -= Deriv[SP];
+                       --SP; break;
+          case   cMul:
+              Deriv[SP-1] = Deriv[SP-1]*Stack[SP] + Stack[SP-1]*Deriv[SP];
+              Stack[SP-1] *= Stack[SP]; --SP; break;
+
+          case   cDiv:
+              if(Stack[SP] == Value_t(0))
+              { evalError=1; return Value_t(0); }
+              Stack[SP-1] /= Stack[SP];
+              Deriv[SP-1] = (Deriv[SP-1] - Stack[SP-1]*Deriv[SP]) / Stack[SP];
+              --SP; break;
+
+          case   cMod:
+              if(Stack[SP] == Value_t(0))
+              { evalError=1; return Value_t(0); }
+              Deriv[SP-1] -= fp_trunc(Stack[SP-1] / Stack[SP]) * Deriv[SP];
+              Stack[SP-1] = fp_mod(Stack[SP-1], Stack[SP]);
+              --SP; break;
+
+          case cEqual:
+              Stack[SP-1] = fp_equal(Stack[SP-1], Stack[SP]);
+              Deriv[SP-1] = Value_t(0); --SP; break;
+
+          case cNEqual:
+              Stack[SP-1] = fp_nequal(Stack[SP-1], Stack[SP]);
+              Deriv[SP-1] = Value_t(0); --SP; break;
+
+          case  cLess:
+              Stack[SP-1] = fp_less(Stack[SP-1], Stack[SP]);
+              Deriv[SP-1] = Value_t(0); --SP; break;
+
+          case  cLessOrEq:
+              Stack[SP-1] = fp_lessOrEq(Stack[SP-1], Stack[SP]);
+              Deriv[SP-1] = Value_t(0); --SP; break;
+
+          case cGreater:
+              Stack[SP-1] = fp_less(Stack[SP], Stack[SP-1]);
+              Deriv[SP-1] = Value_t(0); --SP; break;
+
+          case cGreaterOrEq:
+              Stack[SP-1] = fp_lessOrEq(Stack[SP], Stack[SP-1]);
+              Deriv[SP-1] = Value_t(0); --SP; break;
+
+          case   cNot: Stack[SP] = fp_not(Stack[SP]);
+                       Deriv[SP] = Value_t(0); break;
+
+          case cNotNot: Stack[SP] = fp_notNot(Stack[SP]);
+                        Deriv[SP] = Value_t(0); break;
+
+          case   cAnd:
+              Stack[SP-1] = fp_and(Stack[SP-1], Stack[SP]);
+              Deriv[SP-1] = Value_t(0); --SP; break;
+
+          case    cOr:
+              Stack[SP-1] = fp_or(Stack[SP-1], Stack[SP]);
+              Deriv[SP-1] = Value_t(0); --SP; break;
+
+// Degrees-radians conversion:
+          case   cDeg: Stack[SP] = RadiansToDegrees(Stack[SP]);
+                       Deriv[SP] = RadiansToDegrees(Deriv[SP]); break;
+          case   cRad: Stack[SP] = DegreesToRadians(Stack[SP]);
+                       Deriv[SP] = DegreesToRadians(Deriv[SP]); break;
+
+// User-defined function calls:
+          case cFCall:
+              {
+                  // The derivative of a C++ function is not known, so it
+                  // is approximated with central differences.
+                  const unsigned index = byteCode[++IP];
+                  const typename Data::FuncWrapperPtrData& func = mData->mFuncPtrs[index];
+                  const unsigned params = func.mParams;
+                  Value_t* const first = &Stack[SP-params+1];
+                  const Value_t* const firstDeriv = &Deriv[SP-params+1];
+
+                  std::vector<Value_t>& args = context.mFunctionArguments;
+                  args.assign(first, first + params);
+                  Value_t d = Value_t(0);
+                  for(unsigned p = 0; p < params; ++p)
+                  {
+                      if(firstDeriv[p] == Value_t(0)) continue;
+                      const Value_t step =
+                          Value_t(1e-6) * (Value_t(1) + fp_abs(first[p]));
+                      if(step == Value_t(0)) continue;
+                      args[p] = first[p] + step;
+                      const Value_t above = func.mRawFuncPtr ?
+                          func.mRawFuncPtr(&args[0]) :
+                          func.mFuncWrapperPtr->callFunction(&args[0]);
+                      args[p] = first[p] - step;
+                      const Value_t below = func.mRawFuncPtr ?
+                          func.mRawFuncPtr(&args[0]) :
+                          func.mFuncWrapperPtr->callFunction(&args[0]);
+                      args[p] = first[p];
+                      d += (above - below) / (Value_t(2) * step)
+                           * firstDeriv[p];
+                  }
+
+                  const Value_t retVal =
+                      func.mRawFuncPtr ?
+                      func.mRawFuncPtr(first) :
+                      func.mFuncWrapperPtr->callFunction(first);
+                  SP -= int(params)-1;
+                  Stack[SP] = retVal;
+                  Deriv[SP] = d;
+                  break;
+              }
+
+          case cPCall:
+              {
+                  unsigned index = byteCode[++IP];
+                  unsigned params = mData->mFuncParsers[index].mParams;
+                  const FunctionParserBase<Value_t>* const parser =
+                      mData->mFuncParsers[index].mParserPtr;
+                  EvalContext& nested = context.NestedContext(index);
+                  const unsigned stackSize = parser->mData->mStackSize;
+                  if(nested.mStack.size() < stackSize)
+                      nested.mStack.resize(stackSize);
+                  if(nested.mDerivativeStack.size() < stackSize)
+                      nested.mDerivativeStack.resize(stackSize);
+
+                  Value_t d;
+                  const Value_t retVal = parser->EvalDualWithStack
+                      (&Stack[SP-params+1], &Deriv[SP-params+1],
+                       nested.mStack.data(), nested.mDerivativeStack.data(),
+                       nested, nested.mEvalErrorType, d);
+                  SP -= int(params)-1;
+                  Stack[SP] = retVal;
+                  Deriv[SP] = d;
+                  if(nested.mEvalErrorType)
+                  {
+                      evalError = nested.mEvalErrorType;
+                      return 0;
+                  }
+                  break;
+              }
+
+
+          case   cFetch:
+              {
+                  unsigned stackOffs = byteCode[++IP];
+                  Stack[SP+1] = Stack[stackOffs];
+                  Deriv[SP+1] = Deriv[stackOffs]; ++SP;
+                  break;
+              }
+
+#ifdef FP_SUPPORT_OPTIMIZER
+          case   cPopNMov:
+              {
+                  unsigned stackOffs_target = byteCode[++IP];
+                  unsigned stackOffs_source = byteCode[++IP];
+                  Stack[stackOffs_target] = Stack[stackOffs_source];
+                  Deriv[stackOffs_target] = Deriv[stackOffs_source];
+                  SP = stackOffs_target;
+                  break;
+              }
+
+          case  cLog2by:
+              if(IsComplexType<Value_t>::result
+               ?   Stack[SP-1] == Value_t(0)
+               :   !(Stack[SP-1] > Value_t(0)))
+              { evalError=3; return Value_t(0); }
+              {
+                  const Value_t log2 = fp_log2(Stack[SP-1]);
+                  Deriv[SP-1] = Deriv[SP-1] * Stack[SP]
+                      / (Stack[SP-1] * fp_const_log2<Value_t>())
+                      + log2 * Deriv[SP];
+                  Stack[SP-1] = log2 * Stack[SP];
+              }
+              --SP;
+              break;
+
+          case cNop: break;
+#endif // FP_SUPPORT_OPTIMIZER
+
+          case cSinCos:
+              fp_sinCos(Stack[SP], Stack[SP+1], Stack[SP]);
+              Deriv[SP+1] = -Stack[SP] * Deriv[SP];
+              Deriv[SP] *= Stack[SP+1];
+              ++SP;
+              break;
+          case cSinhCosh:
+              fp_sinhCosh(Stack[SP], Stack[SP+1], Stack[SP]);
+              Deriv[SP+1] = Stack[SP] * Deriv[SP];
+              Deriv[SP] *= Stack[SP+1];
+              ++SP;
+              break;
+
+          case cAbsNot:
+              Stack[SP] = fp_absNot(Stack[SP]);
+              Deriv[SP] = Value_t(0); break;
+          case cAbsNotNot:
+              Stack[SP] = fp_absNotNot(Stack[SP]);
+              Deriv[SP] = Value_t(0); break;
+          case cAbsAnd:
+              Stack[SP-1] = fp_absAnd(Stack[SP-1], Stack[SP]);
+              Deriv[SP-1] = Value_t(0); --SP; break;
+          case cAbsOr:
+              Stack[SP-1] = fp_absOr(Stack[SP-1], Stack[SP]);
+              Deriv[SP-1] = Value_t(0); --SP; break;
+          case cAbsIf:
+              if(fp_absTruth(Stack[SP--]))
+                  IP += 2;
+              else
+              {
+                  const unsigned* buf = &byteCode[IP+1];
+                  IP = buf[0];
+                  DP = buf[1];
+              }
+              break;
+
+          case   cDup: Stack[SP+1] = Stack[SP]; Deriv[SP+1] = Deriv[SP];
+                       ++SP; break;
+
+          case   cInv:
+              if(Stack[SP] == Value_t(0))
+              { evalError=1; return Value_t(0); }
+              Stack[SP] = Value_t(1)/Stack[SP];
+              Deriv[SP] *= -Stack[SP]*Stack[SP];
+              break;
+
+          case   cSqr:
+              Deriv[SP] *= Value_t(2)*Stack[SP];
+              Stack[SP] = Stack[SP]*Stack[SP];
+              break;
+
+          case   cRDiv:
+              if(Stack[SP-1] == Value_t(0))
+              { evalError=1; return Value_t(0); }
+              {
+                  const Value_t divisor = Stack[SP-1];
+                  Stack[SP-1] = Stack[SP] / divisor;
+                  Deriv[SP-1] = (Deriv[SP] - Stack[SP-1]*Deriv[SP-1])
+                      / divisor;
+              }
+              --SP; break;
+
+          case   cRSub: Stack[SP-1] = Stack[SP] - Stack[SP-1];
+                        Deriv[SP-1] = Deriv[SP] - Deriv[SP-1];
+                        --SP; break;
+
+          case   cRSqrt:
+              if(Stack[SP] == Value_t(0))
+              { evalError=1; return Value_t(0); }
+              Deriv[SP] /= Value_t(-2) * Stack[SP];
+              Stack[SP] = Value_t(1) / fp_sqrt(Stack[SP]);
+              Deriv[SP] *= Stack[SP]; break;
+
+#ifdef FP_SUPPORT_COMPLEX_NUMBERS
+          case   cReal: Stack[SP] = fp_real(Stack[SP]);
+                        Deriv[SP] = fp_real(Deriv[SP]); break;
+          case   cImag: Stack[SP] = fp_imag(Stack[SP]);
+                        Deriv[SP] = fp_imag(Deriv[SP]); break;
+          case   cArg:  Deriv[SP] = fp_imag(Deriv[SP] / Stack[SP]);
+                        Stack[SP] = fp_arg(Stack[SP]); break;
+          case   cConj: Stack[SP] = fp_conj(Stack[SP]);
+                        Deriv[SP] = fp_conj(Deriv[SP]); break;
+          case   cPolar:
+              // d(r*e^(it)) = dr*e^(it) + r*dt*e^(i(t+pi/2))
+              Deriv[SP-1] = fp_polar(Deriv[SP-1], Stack[SP])
+                  + fp_polar(Stack[SP-1] * Deriv[SP],
+                             Stack[SP] + fp_const_pi<Value_t>() / Value_t(2));
+              Stack[SP-1] = fp_polar(Stack[SP-1], Stack[SP]);
+              --SP; break;
+#endif
+
+
+// Variables:
+          default:
+              Stack[++SP] = Vars[byteCode[IP]-VarBegin];
+              Deriv[SP] = VarDerivs[byteCode[IP]-VarBegin];
+        }
+    }
+
+    evalError=0;
+    derivative = Deriv[SP];
+    return Stack[SP];
+}
+
+
+//===========================================================================
+// Batch evaluation
+//===========================================================================
+namespace
+{
+    /* Domain checks for a column of n values. Each of them returns true if
+       any of the values would make Eval() fail. The loops intentionally do
+       not exit early so that they can be vectorized by the compiler.
+     */
+    template<typename Value_t>
+    inline bool batchHasZero(const Value_t* x, unsigned n)
+    {
+        bool found = false;
+        for(unsigned i = 0; i < n; ++i) found |= (x[i] == Value_t(0));
+        return found;
+    }
+
+    template<typename Value_t>
+    inline bool batchHasNonPositive(const Value_t* x, unsigned n)
+    {
+        if(IsComplexType<Value_t>::result) return batchHasZero(x, n);
+        bool found = false;
+        for(unsigned i = 0; i < n; ++i) found |= !(x[i] > Value_t(0));
+        return found;
+    }
+
+    template<typename Value_t>
+    inline bool batchHasNegative(const Value_t* x, unsigned n)
+    {
+        if(IsComplexType<Value_t>::result) return false;
+        bool found = false;
+        for(unsigned i = 0; i < n; ++i) found |= (x[i] < Value_t(0));
+        return found;
+    }
+
+    template<typename Value_t>
+    inline bool batchHasBelow(const Value_t* x, unsigned n, Value_t limit)
+    {
+        if(IsComplexType<Value_t>::result) return false;
+        bool found = false;
+        for(unsigned i = 0; i < n; ++i) found |= (x[i] < limit);
+        return found;
+    }
+
+    template<typename Value_t>
+    inline bool batchHasOutsideUnit(const Value_t* x, unsigned n)
+    {
+        if(IsComplexType<Value_t>::result) return false;
+        bool found = false;
+        for(unsigned i = 0; i < n; ++i)
+            found |= (x[i] < Value_t(-1) || x[i] > Value_t(1));
+        return found;
+    }
+
+    template<typename Value_t>
+    inline bool batchHasAtanhPole(const Value_t* x, unsigned n)
+    {
+        bool found = false;
+        for(unsigned i = 0; i < n; ++i)
+            found |= IsComplexType<Value_t>::result
+                ?  (x[i] == Value_t(-1) || x[i] == Value_t(1))
+                :  (x[i] <= Value_t(-1) || x[i] >= Value_t(1));
+        return found;
+    }
+
+    /* Returns true if the condition of cIf (or cAbsIf) takes the same branch
+       for all the n values, storing the branch taken in truth. */
+    template<typename Value_t>
+    inline bool batchSameTruth(const Value_t* x, unsigned n, bool absTruth,
+                               bool& truth)
+    {
+        truth = absTruth ? fp_absTruth(x[0]) : fp_truth(x[0]);
+        for(unsigned i = 1; i < n; ++i)
+            if((absTruth ? fp_absTruth(x[i]) : fp_truth(x[i])) != truth)
+                return false;
+        return true;
+    }
+}
+
+/* Evaluates the bytecode for n <= FP_EVAL_BATCH_BLOCK_SIZE sets of variables
+   at once. The stack is stored column-wise: each stack position holds the
+   n values of that position, so every opcode is dispatched only once for
+   the whole block, and the arithmetic opcodes use the vectorized kernels
+   of fpsimd.hh. Two dummy columns precede the first stack position so
+   that the columns of SP and SP-1 can always be computed, and the stack is
+   followed by mStackSize values of scratch space used for gathering the
+   parameters of user-defined function calls.
+
+   Returns false if any of the evaluations fails or if the evaluations take
+   different branches; the caller is then expected to fall back to
+   EvalWithStack().
+ */
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::EvalBatchBlock
+(const Value_t* Vars, unsigned n, Value_t* Results, Value_t* Stack,
+ EvalContext* context) const
+{
+    const unsigned Block = FP_EVAL_BATCH_BLOCK_SIZE;
+    const unsigned* const byteCode = &(mData->mByteCode[0]);
+    const Value_t* const immed = mData->mImmed.empty() ? 0 : &(mData->mImmed[0]);
+    const unsigned byteCodeSize = unsigned(mData->mByteCode.size());
+    const unsigned varsAmount = mData->mVariablesAmount;
+    Value_t* const Scratch = Stack + (mData->mStackSize + 2) * Block;
+    unsigned IP, DP=0;
+    int SP=-1;
+
+    for(IP=0; IP<byteCodeSize; ++IP)
+    {
+        // x is the column of Stack[SP], y the column of Stack[SP-1] and
+        // z the column of Stack[SP+1]
+        Value_t* const x = Stack + unsigned(SP+2) * Block;
+        Value_t* const y = x - Block;
+        Value_t* const z = x + Block;
+
+        switch(byteCode[IP])
+        {
+// Functions:
+          case   cAbs:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_abs(x[i]);
+              break;
+
+          case  cAcos:
+              if(batchHasOutsideUnit(x, n)) return false;
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_acos(x[i]);
+              break;
+
+          case cAcosh:
+              if(batchHasBelow(x, n, Value_t(1))) return false;
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_acosh(x[i]);
+              break;
+
+          case  cAsin:
+              if(batchHasOutsideUnit(x, n)) return false;
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_asin(x[i]);
+              break;
+
+          case cAsinh:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_asinh(x[i]);
+              break;
+
+          case  cAtan:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_atan(x[i]);
+              break;
+
+          case cAtan2:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_atan2(y[i], x[i]);
+              --SP; break;
+
+          case cAtanh:
+              if(batchHasAtanhPole(x, n)) return false;
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_atanh(x[i]);
+              break;
+
+          case  cCbrt:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_cbrt(x[i]);
+              break;
+
+          case  cCeil:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_ceil(x[i]);
+              break;
+
+          case   cCos:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_cos(x[i]);
+              break;
+
+          case  cCosh:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_cosh(x[i]);
+              break;
+
+          case   cCot:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_tan(x[i]);
+              if(batchHasZero(x, n)) return false;
+              for(unsigned i = 0; i < n; ++i) x[i] = Value_t(1)/x[i];
+              break;
+
+          case   cCsc:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_sin(x[i]);
+              if(batchHasZero(x, n)) return false;
+              for(unsigned i = 0; i < n; ++i) x[i] = Value_t(1)/x[i];
+              break;
+
+          case   cExp:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_exp(x[i]);
+              break;
+
+          case  cExp2:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_exp2(x[i]);
+              break;
+
+          case cFloor:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_floor(x[i]);
+              break;
+
+          case cHypot:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_hypot(y[i], x[i]);
+              --SP; break;
+
+          case    cIf:
+          case cAbsIf:
+              {
+                  bool truth;
+                  if(!batchSameTruth(x, n, byteCode[IP] == cAbsIf, truth))
+                      return false;
+                  --SP;
+                  if(truth)
+                      IP += 2;
+                  else
+                  {
+                      const unsigned* buf = &byteCode[IP+1];
+                      IP = buf[0];
+                      DP = buf[1];
+                  }
+                  break;
+              }
+
+          case   cInt:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_int(x[i]);
+              break;
+
+          case   cLog:
+              if(batchHasNonPositive(x, n)) return false;
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_log(x[i]);
+              break;
+
+          case cLog10:
+              if(batchHasNonPositive(x, n)) return false;
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_log10(x[i]);
+              break;
+
+          case  cLog2:
+              if(batchHasNonPositive(x, n)) return false;
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_log2(x[i]);
+              break;
+
+          case   cMax:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_max(y[i], x[i]);
+              --SP; break;
+
+          case   cMin:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_min(y[i], x[i]);
+              --SP; break;
+
+          case   cPow:
+              {
+                  // x:0 ^ y:negative is failure
+                  bool failure = false;
+                  for(unsigned i = 0; i < n; ++i)
+                      failure |= (y[i] == Value_t(0) && x[i] < Value_t(0));
+                  if(failure) return false;
+                  for(unsigned i = 0; i < n; ++i) y[i] = fp_pow(y[i], x[i]);
+                  --SP; break;
+              }
+
+          case  cTrunc:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_trunc(x[i]);
+              break;
+
+          case   cSec:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_cos(x[i]);
+              if(batchHasZero(x, n)) return false;
+              for(unsigned i = 0; i < n; ++i) x[i] = Value_t(1)/x[i];
+              break;
+
+          case   cSin:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_sin(x[i]);
+              break;
+
+          case  cSinh:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_sinh(x[i]);
+              break;
+
+          case  cSqrt:
+              if(batchHasNegative(x, n)) return false;
+              BatchKernels<Value_t>::sqrt(x, n);
+              break;
+
+          case   cTan:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_tan(x[i]);
+              break;
+
+          case  cTanh:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_tanh(x[i]);
+              break;
+
+
+// Misc:
+          case cImmed:
+              {
+                  const Value_t value = immed[DP++];
+                  for(unsigned i = 0; i < n; ++i) z[i] = value;
+                  ++SP; break;
+              }
+
+          case  cJump:
+              {
+                  const unsigned* buf = &byteCode[IP+1];
+                  IP = buf[0];
+                  DP = buf[1];
+                  break;
+              }
+
+// Operators:
+          case   cNeg: BatchKernels<Value_t>::neg(x, n); break;
+          case   cAdd: BatchKernels<Value_t>::add(y, x, n); --SP; break;
+          case   cSub: BatchKernels<Value_t>::sub(y, x, n); --SP; break;
+          case   cMul: BatchKernels<Value_t>::mul(y, x, n); --SP; break;
+
+          case   cDiv:
+              if(batchHasZero(x, n)) return false;
+              BatchKernels<Value_t>::div(y, x, n);
+              --SP; break;
+
+          case   cMod:
+              if(batchHasZero(x, n)) return false;
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_mod(y[i], x[i]);
+              --SP; break;
+
+          case cEqual:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_equal(y[i], x[i]);
+              --SP; break;
+
+          case cNEqual:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_nequal(y[i], x[i]);
+              --SP; break;
+
+          case  cLess:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_less(y[i], x[i]);
+              --SP; break;
+
+          case  cLessOrEq:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_lessOrEq(y[i], x[i]);
+              --SP; break;
+
+          case cGreater:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_less(x[i], y[i]);
+              --SP; break;
+
+          case cGreaterOrEq:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_lessOrEq(x[i], y[i]);
+              --SP; break;
+
+          case   cNot:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_not(x[i]);
+              break;
+
+          case cNotNot:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_notNot(x[i]);
+              break;
+
+          case   cAnd:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_and(y[i], x[i]);
+              --SP; break;
+
+          case    cOr:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_or(y[i], x[i]);
+              --SP; break;
+
+// Degrees-radians conversion:
+          case   cDeg:
+              for(unsigned i = 0; i < n; ++i) x[i] = RadiansToDegrees(x[i]);
+              break;
+
+          case   cRad:
+              for(unsigned i = 0; i < n; ++i) x[i] = DegreesToRadians(x[i]);
+              break;
+
+// User-defined function calls:
+          case cFCall:
+              {
+                  const unsigned index = byteCode[++IP];
+                  const unsigned params = mData->mFuncPtrs[index].mParams;
+                  Value_t* const first = z - params * Block;
+                  for(unsigned i = 0; i < n; ++i)
+                  {
+                      for(unsigned p = 0; p < params; ++p)
+                          Scratch[p] = first[p * Block + i];
+                      first[i] =
+                          mData->mFuncPtrs[index].mRawFuncPtr ?
+                          mData->mFuncPtrs[index].mRawFuncPtr(Scratch) :
+                          mData->mFuncPtrs[index].mFuncWrapperPtr->callFunction
+                          (Scratch);
+                  }
+                  SP -= int(params)-1;
+                  break;
+              }
+
+          case cPCall:
+              {
+                  const unsigned index = byteCode[++IP];
+                  const unsigned params = mData->mFuncParsers[index].mParams;
+                  FunctionParserBase<Value_t>* const parser =
+                      mData->mFuncParsers[index].mParserPtr;
+                  Value_t* const first = z - params * Block;
+                  for(unsigned i = 0; i < n; ++i)
+                  {
+                      for(unsigned p = 0; p < params; ++p)
+                          Scratch[p] = first[p * Block + i];
+                      if(context)
+                      {
+                          EvalContext& nested = context->NestedContext(index);
+                          first[i] = parser->Eval(nested, Scratch);
+                          if(nested.EvalError()) return false;
+                      }
+                      else
+                      {
+                          first[i] = parser->Eval(Scratch);
+                          if(parser->EvalError()) return false;
+                      }
+                  }
+                  SP -= int(params)-1;
+                  break;
+              }
+
+
+          case   cFetch:
+              {
+                  const Value_t* const source =
+                      Stack + (byteCode[++IP] + 2) * Block;
+                  for(unsigned i = 0; i < n; ++i) z[i] = source[i];
+                  ++SP; break;
+              }
+
+#ifdef FP_SUPPORT_OPTIMIZER
+          case   cPopNMov:
+              {
+                  unsigned stackOffs_target = byteCode[++IP];
+                  unsigned stackOffs_source = byteCode[++IP];
+                  Value_t* const target = Stack + (stackOffs_target + 2) * Block;
+                  const Value_t* const source =
+                      Stack + (stackOffs_source + 2) * Block;
+                  for(unsigned i = 0; i < n; ++i) target[i] = source[i];
+                  SP = stackOffs_target;
+                  break;
+              }
+
+          case  cLog2by:
+              if(batchHasNonPositive(y, n)) return false;
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_log2(y[i]) * x[i];
+              --SP; break;
+
+          case cNop: break;
+#endif // FP_SUPPORT_OPTIMIZER
+
+          case cSinCos:
+              for(unsigned i = 0; i < n; ++i) fp_sinCos(x[i], z[i], x[i]);
+              ++SP; break;
+
+          case cSinhCosh:
+              for(unsigned i = 0; i < n; ++i) fp_sinhCosh(x[i], z[i], x[i]);
+              ++SP; break;
+
+          case cAbsNot:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_absNot(x[i]);
+              break;
+
+          case cAbsNotNot:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_absNotNot(x[i]);
+              break;
+
+          case cAbsAnd:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_absAnd(y[i], x[i]);
+              --SP; break;
+
+          case cAbsOr:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_absOr(y[i], x[i]);
+              --SP; break;
+
+          case   cDup:
+              for(unsigned i = 0; i < n; ++i) z[i] = x[i];
+              ++SP; break;
+
+          case   cInv:
+              if(batchHasZero(x, n)) return false;
+              BatchKernels<Value_t>::inv(x, n);
+              break;
+
+          case   cSqr: BatchKernels<Value_t>::sqr(x, n); break;
+
+          case   cRDiv:
+              if(batchHasZero(y, n)) return false;
+              BatchKernels<Value_t>::rdiv(y, x, n);
+              --SP; break;
+
+          case   cRSub: BatchKernels<Value_t>::rsub(y, x, n); --SP; break;
+
+          case   cRSqrt:
+              if(batchHasZero(x, n)) return false;
+              BatchKernels<Value_t>::rsqrt(x, n);
+              break;
+
+#ifdef FP_SUPPORT_COMPLEX_NUMBERS
+          case   cReal:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_real(x[i]);
+              break;
+
+          case   cImag:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_imag(x[i]);
+              break;
+
+          case   cArg:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_arg(x[i]);
+              break;
+
+          case   cConj:
+              for(unsigned i = 0; i < n; ++i) x[i] = fp_conj(x[i]);
+              break;
+
+          case   cPolar:
+              for(unsigned i = 0; i < n; ++i) y[i] = fp_polar(y[i], x[i]);
+              --SP; break;
+#endif
+
+
+// Variables:
+          default:
+              {
+                  const Value_t* const var = Vars + (byteCode[IP]-VarBegin);
+                  for(unsigned i = 0; i < n; ++i) z[i] = var[i * varsAmount];
+                  ++SP;
+              }
+        }
+    }
+
+    const Value_t* const result = Stack + unsigned(SP+2) * Block;
+    for(unsigned i = 0; i < n; ++i) Results[i] = result[i];
+    return true;
+}
+
+template<typename Value_t>
+void FunctionParserBase<Value_t>::EvalBatch(const Value_t* Vars,
+                                            std::size_t count,
+                                            Value_t* Results)
+{
+    if(mData->mParseErrorType != FP_NO_ERROR)
+    {
+        for(std::size_t i = 0; i < count; ++i) Results[i] = Value_t(0);
+        return;
+    }
+
+    const std::size_t batchStackSize =
+        std::size_t(mData->mStackSize + 2) * FP_EVAL_BATCH_BLOCK_SIZE
+        + mData->mStackSize;
+
+#ifdef FP_USE_THREAD_SAFE_EVAL
+    /* One stack is allocated for the whole batch, followed by the stack
+       used when falling back to evaluating the values one by one. */
+    std::vector<Value_t> batchStack(batchStackSize + mData->mStackSize);
+    Value_t* const Stack = &batchStack[batchStackSize];
+#else
+    std::vector<Value_t>& batchStack = mData->mBatchStack;
+    if(batchStack.size() < batchStackSize) batchStack.resize(batchStackSize);
+    Value_t* const Stack = &mData->mStack[0];
+#endif
+
+    EvalBatchWithStacks(Vars, count, Results, &batchStack[0], Stack, 0,
+                        mData->mEvalErrorType);
+}
+
+template<typename Value_t>
+void FunctionParserBase<Value_t>::EvalBatch(EvalContext& context,
+                                            const Value_t* Vars,
+                                            std::size_t count,
+                                            Value_t* Results) const
+{
+    if(mData->mParseErrorType != FP_NO_ERROR)
+    {
+        for(std::size_t i = 0; i < count; ++i) Results[i] = Value_t(0);
+        return;
+    }
+
+    const std::size_t batchStackSize =
+        std::size_t(mData->mStackSize + 2) * FP_EVAL_BATCH_BLOCK_SIZE
+        + mData->mStackSize;
+
+    if(context.mBatchStack.size() < batchStackSize)
+        context.mBatchStack.resize(batchStackSize);
+    if(context.mStack.size() < mData->mStackSize)
+        context.mStack.resize(mData->mStackSize);
+
+    EvalBatchWithStacks(Vars, count, Results, &context.mBatchStack[0],
+                        &context.mStack[0], &context, context.mEvalErrorType);
+}
+
+template<typename Value_t>
+void FunctionParserBase<Value_t>::EvalBatchWithStacks
+(const Value_t* Vars, std::size_t count, Value_t* Results,
+ Value_t* BatchStack, Value_t* Stack, EvalContext* context,
+ int& evalError) const
+{
+    const unsigned Block = FP_EVAL_BATCH_BLOCK_SIZE;
+    const unsigned varsAmount = mData->mVariablesAmount;
+    int firstError = 0;
+
+    for(std::size_t begin = 0; begin < count; begin += Block)
+    {
+        const unsigned n =
+            unsigned(count - begin < Block ? count - begin : Block);
+        const Value_t* const vars = Vars + begin * varsAmount;
+
+        if(!EvalBatchBlock(vars, n, Results + begin, BatchStack, context))
+        {
+            /* Evaluate the block one by one to get the exact results and
+               errors of Eval(). */
+            for(unsigned i = 0; i < n; ++i)
+            {
+                int error;
+                Results[begin + i] =
+                    EvalWithStack(vars + i * varsAmount, Stack, context, error);
+                if(firstError == 0) firstError = error;
+            }
+        }
+    }
+
+    evalError = firstError;
+}
+
+
+//===========================================================================
+// Symbolic differentiation
+//===========================================================================
+namespace
+{
+    /* The derivative is built as a string which is then parsed. An empty
+       string stands for a zero derivative, so that the terms which do not
+       depend on the variable disappear. The operators always put their
+       result in parentheses, so the results can be combined freely.
+     */
+    std::string symAdd(const std::string& a, const std::string& b)
+    {
+        if(a.empty()) return b;
+        if(b.empty()) return a;
+        return "(" + a + "+" + b + ")";
+    }
+
+    std::string symSub(const std::string& a, const std::string& b)
+    {
+        if(b.empty()) return a;
+        if(a.empty()) return "(-" + b + ")";
+        return "(" + a + "-" + b + ")";
+    }
+
+    std::string symMul(const std::string& a, const std::string& b)
+    {
+        if(a.empty() || b.empty()) return std::string();
+        return "(" + a + "*" + b + ")";
+    }
+
+    std::string symDiv(const std::string& a, const std::string& b)
+    {
+        if(a.empty()) return std::string();
+        return "(" + a + "/" + b + ")";
+    }
+
+    std::string symNeg(const std::string& a)
+    {
+        if(a.empty()) return std::string();
+        return "(-" + a + ")";
+    }
+
+    std::string symCall(const char* name, const std::string& a)
+    {
+        return std::string(name) + "(" + a + ")";
+    }
+
+    std::string symCall(const char* name, const std::string& a,
+                        const std::string& b)
+    {
+        return std::string(name) + "(" + a + "," + b + ")";
+    }
+
+    std::string symIf(const std::string& cond, const std::string& a,
+                      const std::string& b)
+    {
+        return "if(" + cond + "," + (a.empty() ? "0" : a) + ","
+            + (b.empty() ? "0" : b) + ")";
+    }
+
+    // Enough digits to read back the same value
+    template<typename Value_t>
+    int symPrecision(const Value_t&)
+    {
+        return std::numeric_limits<Value_t>::digits10 + 3;
+    }
+
+#ifdef FP_SUPPORT_MPFR_FLOAT_TYPE
+    int symPrecision(const MpfrFloat&)
+    {
+        return int(MpfrFloat::getCurrentDefaultMantissaBits() * 0.30103) + 3;
+    }
+#endif
+
+    template<typename Value_t>
+    std::string symLiteral(const Value_t& value)
+    {
+        std::ostringstream stream;
+        stream.precision(symPrecision(value));
+        stream << value;
+        const std::string literal = stream.str();
+        return literal[0] == '-' ? "(" + literal + ")" : literal;
+    }
+
+#ifdef FP_SUPPORT_COMPLEX_NUMBERS
+    template<typename T>
+    std::string symLiteral(const std::complex<T>& value)
+    {
+        const std::string imag = symLiteral(fp_abs(value.imag()));
+        return "(" + symLiteral(value.real())
+            + (value.imag() < T(0) ? "-" : "+") + imag + "i)";
+    }
+#endif
+}
+
+/* A value used more than once by the derivative (a cFetch or cDup of an
+   inline variable or of a common subexpression, for example) is given a
+   name, defined as an inline variable at the start of the derivative's
+   expression, so that it's not copied into each use. A value computed in a
+   branch of an if() is defined as if(conditions,value,0): the definition is
+   evaluated even when the branch isn't taken, and mustn't fail there.
+ */
+template<typename Value_t>
+struct FunctionParserBase<Value_t>::SymbolicNames
+{
+    const Data* mData;
+    const std::vector<std::string>* mVariables;
+    std::string mDefinitions;
+    unsigned mCount;
+
+    // The conditions of the branches being followed, with the stack pointer
+    // each branch started from. mGuard holds the conditions of the branch
+    // calling the function parser being followed.
+    std::vector<std::pair<int, std::string> > mBranches;
+    std::string mGuard;
+
+    SymbolicNames(const Data* data, const std::vector<std::string>& vars):
+        mData(data), mVariables(&vars), mCount(0) {}
+
+    // The conditions under which the value at the stack index was computed
+    const std::string& guard(int index) const
+    {
+        for(std::size_t i = mBranches.size(); i-- > 0; )
+            if(mBranches[i].first < index) return mBranches[i].second;
+        return mGuard;
+    }
+
+    void enterBranch(int SP, const std::string& condition)
+    {
+        const std::string& enclosing = guard(SP+1);
+        mBranches.push_back(std::make_pair
+                            (SP, enclosing.empty() ? condition :
+                             "(" + enclosing + "&" + condition + ")"));
+    }
+
+    bool taken(const std::string& name) const
+    {
+        for(std::size_t i = 0; i < mVariables->size(); ++i)
+            if((*mVariables)[i] == name) return true;
+
+        const NamePtr namePtr(name.data(), unsigned(name.size()));
+        if(mData->mNamePtrs.find(namePtr) != mData->mNamePtrs.end()
+        || mData->mImportedNames.find(namePtr) != mData->mImportedNames.end())
+            return true;
+        for(const Data* table = mData->mSymbolTable.mData; table;
+            table = table->mSymbolTable.mData)
+        {
+            if(table->mNamePtrs.find(namePtr) != table->mNamePtrs.end())
+                return true;
+        }
+        return false;
+    }
+
+    // Replaces the value at the stack index by its name, unless it's
+    // already a name or a literal
+    void define(std::string& value, int index)
+    {
+        if(value.find_first_of("()") == std::string::npos) return;
+
+        std::string name;
+        do
+        {
+            std::ostringstream stream;
+            stream << "_d" << mCount++;
+            name = stream.str();
+        } while(taken(name));
+
+        const std::string& conditions = guard(index);
+        mDefinitions += name + ":="
+            + (conditions.empty() ? value : symIf(conditions, value, "0"))
+            + ";";
+        value = name;
+    }
+};
+
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::Differentiate
+(FunctionParserBase& Result, unsigned VarIndex) const
+{
+    if(mData->mParseErrorType != FP_NO_ERROR
+    || VarIndex >= mData->mVariablesAmount)
+        return false;
+
+    std::vector<std::string> vars, seeds(mData->mVariablesAmount);
+    const std::string& varString = mData->mVariablesString;
+    for(std::size_t begin = 0; begin <= varString.size(); )
+    {
+        std::size_t end = varString.find(',', begin);
+        if(end == std::string::npos) end = varString.size();
+        std::size_t first = begin, last = end;
+        while(first < last && std::isspace(varString[first])) ++first;
+        while(last > first && std::isspace(varString[last-1])) --last;
+        vars.push_back(varString.substr(first, last - first));
+        begin = end + 1;
+    }
+    if(vars.size() != mData->mVariablesAmount) return false;
+    seeds[VarIndex] = "1";
+
+    std::string value, derivative;
+    SymbolicNames names(mData, vars);
+    if(!DifferentiateByteCode(vars, seeds, value, derivative, names))
+        return false;
+    if(derivative.empty()) derivative = "0";
+    derivative = names.mDefinitions + derivative;
+
+    // The copy keeps the constants, units and functions of this parser
+    FunctionParserBase<Value_t> result(*this);
+    if(result.Parse(derivative, varString) >= 0) return false;
+    result.Optimize();
+    Result = result;
+    return true;
+}
+
+/* Goes through the bytecode like EvalDualWithStack(), but with strings
+   instead of values. Vars holds the expressions of the variables and
+   VarDerivs their derivatives. Both branches of the if()s are followed:
+   the then-branch ends with the cJump that skips the else-branch, and the
+   else-branch ends where that cJump goes. The optimizer can make that cJump
+   go directly to the end of an enclosing if(), in which case the
+   else-branch ends at the cJump ending the enclosing then-branch. Names
+   holds the definitions of the values used more than once.
+ */
+template<typename Value_t>
+bool FunctionParserBase<Value_t>::DifferentiateByteCode
+(const std::vector<std::string>& Vars,
+ const std::vector<std::string>& VarDerivs,
+ std::string& Value, std::string& Derivative, SymbolicNames& Names) const
+{
+    struct PendingIf
+    {
+        unsigned jumpIP, endIP;
+        int SP;
+        bool inElse;
+        std::string cond, thenValue, thenDeriv;
+    };
+
+    const std::vector<unsigned>& byteCode = mData->mByteCode;
+    const unsigned byteCodeSize = unsigned(byteCode.size());
+    std::vector<std::string> Stack(mData->mStackSize), Deriv(mData->mStackSize);
+    std::vector<PendingIf> pendingIfs;
+    unsigned DP = 0;
+    int SP = -1;
+
+    for(unsigned IP = 0; ; ++IP)
+    {
+        // The else-branches ending here
+        while(!pendingIfs.empty() && pendingIfs.back().inElse
+           && (pendingIfs.back().endIP == IP
+            || (IP < byteCodeSize && byteCode[IP] == cJump)))
+        {
+            const PendingIf& pending = pendingIfs.back();
+            if(SP != pending.SP + 1) return false;
+            if(!pending.thenDeriv.empty() || !Deriv[SP].empty())
+                Deriv[SP] = symIf(pending.cond, pending.thenDeriv, Deriv[SP]);
+            Stack[SP] = symIf(pending.cond, pending.thenValue, Stack[SP]);
+            pendingIfs.pop_back();
+            Names.mBranches.pop_back();
+        }
+        if(IP >= byteCodeSize) break;
+
+        std::string& x = Stack[SP < 0 ? 0 : SP];
+        std::string& d = Deriv[SP < 0 ? 0 : SP];
+        std::string& a = Stack[SP < 1 ? 0 : SP-1];
+        std::string& da = Deriv[SP < 1 ? 0 : SP-1];
+
+        switch(byteCode[IP])
+        {
+// Functions:
+          case   cAbs:
+              Names.define(d, SP);
+              if(!d.empty()) d = symIf("(" + x + "<0)", symNeg(d), d);
+              x = symCall("abs", x); break;
+
+          case  cAcos:
+              d = symNeg(symDiv(d, symCall("sqrt", "(1-" + x + "^2)")));
+              x = symCall("acos", x); break;
+
+          case cAcosh:
+              d = symDiv(d, symCall("sqrt", "(" + x + "^2-1)"));
+              x = symCall("acosh", x); break;
+
+          case  cAsin:
+              d = symDiv(d, symCall("sqrt", "(1-" + x + "^2)"));
+              x = symCall("asin", x); break;
+
+          case cAsinh:
+              d = symDiv(d, symCall("sqrt", "(" + x + "^2+1)"));
+              x = symCall("asinh", x); break;
+
+          case  cAtan:
+              d = symDiv(d, "(1+" + x + "^2)");
+              x = symCall("atan", x); break;
+
+          case cAtan2:
+              da = symDiv(symSub(symMul(x, da), symMul(a, d)),
+                          "(" + a + "^2+" + x + "^2)");
+              a = symCall("atan2", a, x);
+              --SP; break;
+
+          case cAtanh:
+              d = symDiv(d, "(1-" + x + "^2)");
+              x = symCall("atanh", x); break;
+
+          case  cCbrt:
+              d = symDiv(d, "(3*" + symCall("cbrt", x) + "^2)");
+              x = symCall("cbrt", x); break;
+
+          case  cCeil: d.clear(); x = symCall("ceil", x); break;
+
+          case   cCos:
+              d = symNeg(symMul(symCall("sin", x), d));
+              x = symCall("cos", x); break;
+
+          case  cCosh:
+              d = symMul(symCall("sinh", x), d);
+              x = symCall("cosh", x); break;
+
+          case   cCot:
+              d = symMul("(-(1+" + symCall("cot", x) + "^2))", d);
+              x = symCall("cot", x); break;
+
+          case   cCsc:
+              d = symMul("(-" + symCall("csc", x) + "*"
+                         + symCall("cot", x) + ")", d);
+              x = symCall("csc", x); break;
+
+          case   cExp:
+              x = symCall("exp", x);
+              d = symMul(x, d); break;
+
+          case   cExp2:
+              x = symCall("exp2", x);
+              d = symMul("(" + x + "*" + symLiteral(fp_const_log2<Value_t>())
+                         + ")", d); break;
+
+          case cFloor: d.clear(); x = symCall("floor", x); break;
+
+          case cHypot:
+              {
+                  const std::string result = symCall("hypot", a, x);
+                  da = symDiv(symAdd(symMul(a, da), symMul(x, d)), result);
+                  a = result;
+                  --SP; break;
+              }
+
+          case    cIf:
+          case cAbsIf:
+              {
+                  PendingIf pending;
+                  Names.define(x, SP);
+                  pending.cond = byteCode[IP] == cIf ?
+                      x : symCall("max", x, "0");
+                  --SP;
+                  // The cIf jumps to the else-branch, which is right after
+                  // the cJump (and its two parameters) ending the then-branch
+                  pending.jumpIP = byteCode[IP+1] + 1 - 3;
+                  if(pending.jumpIP >= byteCodeSize
+                  || byteCode[pending.jumpIP] != cJump)
+                      return false;
+                  pending.endIP = byteCode[pending.jumpIP+1] + 1;
+                  pending.SP = SP;
+                  pending.inElse = false;
+                  pendingIfs.push_back(pending);
+                  Names.enterBranch(SP, pending.cond);
+                  IP += 2;
+                  break;
+              }
+
+          case   cInt: d.clear(); x = symCall("int", x); break;
+
+          case   cLog:
+              d = symDiv(d, x);
+              x = symCall("log", x); break;
+
+          case cLog10:
+              d = symDiv(d, "(" + x + "*"
+                         + symLiteral(fp_const_log10<Value_t>()) + ")");
+              x = symCall("log10", x); break;
+
+          case  cLog2:
+              d = symDiv(d, "(" + x + "*"
+                         + symLiteral(fp_const_log2<Value_t>()) + ")");
+              x = symCall("log2", x); break;
+
+          case   cMax:
+              if(!da.empty() || !d.empty())
+                  da = symIf("(" + a + "<" + x + ")", d, da);
+              a = symCall("max", a, x);
+              --SP; break;
+
+          case   cMin:
+              if(!da.empty() || !d.empty())
+                  da = symIf("(" + x + "<" + a + ")", d, da);
+              a = symCall("min", a, x);
+              --SP; break;
+
+          case   cPow:
+              {
+                  const std::string result = "(" + a + "^" + x + ")";
+                  da = symAdd
+                      (symMul(symMul(x, "(" + a + "^(" + x + "-1))"), da),
+                       symMul(symMul(result, symCall("log", a)), d));
+                  a = result;
+                  --SP; break;
+              }
+
+          case  cTrunc: d.clear(); x = symCall("trunc", x); break;
+
+          case   cSec:
+              d = symMul("(" + symCall("sec", x) + "*"
+                         + symCall("tan", x) + ")", d);
+              x = symCall("sec", x); break;
+
+          case   cSin:
+              d = symMul(symCall("cos", x), d);
+              x = symCall("sin", x); break;
+
+          case  cSinh:
+              d = symMul(symCall("cosh", x), d);
+              x = symCall("sinh", x); break;
+
+          case  cSqrt:
+              x = symCall("sqrt", x);
+              d = symDiv(d, "(2*" + x + ")"); break;
+
+          case   cTan:
+              x = symCall("tan", x);
+              d = symMul("(1+" + x + "^2)", d); break;
+
+          case  cTanh:
+              x = symCall("tanh", x);
+              d = symMul("(1-" + x + "^2)", d); break;
+
+
+// Misc:
+          case cImmed:
+              ++SP;
+              Stack[SP] = symLiteral(mData->mImmed[DP++]);
+              Deriv[SP].clear();
+              break;
+
+          case  cJump:
+              // The end of a then-branch: the else-branch follows
+              if(pendingIfs.empty() || pendingIfs.back().jumpIP != IP
+              || SP != pendingIfs.back().SP + 1)
+                  return false;
+              pendingIfs.back().thenValue = x;
+              pendingIfs.back().thenDeriv = d;
+              pendingIfs.back().inElse = true;
+              Names.mBranches.pop_back();
+              Names.enterBranch(pendingIfs.back().SP,
+                                "(!" + pendingIfs.back().cond + ")");
+              --SP;
+              IP += 2;
+              break;
+
+// Operators:
+          case   cNeg: d = symNeg(d); x = "(-" + x + ")"; break;
+          case   cAdd: da = symAdd(da, d); a = "(" + a + "+" + x + ")";
+                       --SP; break;
+          case   cSub: da = symSub(da, d); a = "(" + a + "-" + x + ")";
+                       --SP; break;
+          case   cMul:
+              da = symAdd(symMul(da, x), symMul(a, d));
+              a = "(" + a + "*" + x + ")";
+              --SP; break;
+
+          case   cDiv:
+              da = symDiv(symSub(symMul(da, x), symMul(a, d)),
+                          "(" + x + "^2)");
+              a = "(" + a + "/" + x + ")";
+              --SP; break;
+
+          case   cMod:
+              da = symSub(da, symMul(symCall("trunc", "(" + a + "/" + x + ")"),
+                                     d));
+              a = "(" + a + "%" + x + ")";
+              --SP; break;
+
+          case cEqual: da.clear(); a = "(" + a + "=" + x + ")"; --SP; break;
+          case cNEqual: da.clear(); a = "(" + a + "!=" + x + ")"; --SP; break;
+          case  cLess: da.clear(); a = "(" + a + "<" + x + ")"; --SP; break;
+          case  cLessOrEq: da.clear(); a = "(" + a + "<=" + x + ")"; --SP; break;
+          case cGreater: da.clear(); a = "(" + a + ">" + x + ")"; --SP; break;
+          case cGreaterOrEq: da.clear(); a = "(" + a + ">=" + x + ")"; --SP; break;
+
+          case   cNot: d.clear(); x = "(!" + x + ")"; break;
+          case cNotNot: d.clear(); x = "(!!" + x + ")"; break;
+          case   cAnd: da.clear(); a = "(" + a + "&" + x + ")"; --SP; break;
+          case    cOr: da.clear(); a = "(" + a + "|" + x + ")"; --SP; break;
+
+          // The truth value of the "abs" versions is the one of max(x,0)
+          case cAbsNot:
+              d.clear(); x = "(!" + symCall("max", x, "0") + ")"; break;
+          case cAbsNotNot:
+              d.clear(); x = "(!!" + symCall("max", x, "0") + ")"; break;
+          case cAbsAnd:
+              da.clear();
+              a = "(" + symCall("max", a, "0") + "&"
+                  + symCall("max", x, "0") + ")";
+              --SP; break;
+          case cAbsOr:
+              da.clear();
+              a = "(" + symCall("max", a, "0") + "|"
+                  + symCall("max", x, "0") + ")";
+              --SP; break;
+
+// Degrees-radians conversion:
+          case   cDeg:
+              {
+                  const std::string factor =
+                      symLiteral(fp_const_rad_to_deg<Value_t>());
+                  d = symMul(d, factor);
+                  x = "(" + x + "*" + factor + ")";
+                  break;
+              }
+          case   cRad:
+              {
+                  const std::string factor =
+                      symLiteral(fp_const_deg_to_rad<Value_t>());
+                  d = symMul(d, factor);
+                  x = "(" + x + "*" + factor + ")";
+                  break;
+              }
+
+// User-defined function calls:
+          case cFCall:
+              // The derivative of a C++ function is not known
+              return false;
+
+          case cPCall:
+              {
+                  // The parser is inlined, with the parameters as variables
+                  unsigned index = byteCode[++IP];
+                  unsigned params = mData->mFuncParsers[index].mParams;
+                  const FunctionParserBase<Value_t>* const parser =
+                      mData->mFuncParsers[index].mParserPtr;
+                  for(int arg = SP-int(params)+1; arg <= SP; ++arg)
+                  {
+                      Names.define(Stack[arg], arg);
+                      Names.define(Deriv[arg], arg);
+                  }
+                  const std::vector<std::string>
+                      args(&Stack[SP-params+1], &Stack[SP+1]),
+                      argDerivs(&Deriv[SP-params+1], &Deriv[SP+1]);
+                  // The parser is followed under the conditions of the
+                  // branch calling it
+                  std::vector<std::pair<int, std::string> > branches;
+                  std::string guard = Names.guard(SP+1);
+                  branches.swap(Names.mBranches);
+                  guard.swap(Names.mGuard);
+                  SP -= int(params)-1;
+                  const bool differentiated =
+                      parser->DifferentiateByteCode(args, argDerivs, Stack[SP],
+                                                    Deriv[SP], Names);
+                  branches.swap(Names.mBranches);
+                  guard.swap(Names.mGuard);
+                  if(!differentiated) return false;
+                  break;
+              }
+
+
+          case   cFetch:
+              {
+                  unsigned stackOffs = byteCode[++IP];
+                  Names.define(Stack[stackOffs], int(stackOffs));
+                  Names.define(Deriv[stackOffs], int(stackOffs));
+                  Stack[SP+1] = Stack[stackOffs];
+                  Deriv[SP+1] = Deriv[stackOffs]; ++SP;
+                  break;
+              }
+
+#ifdef FP_SUPPORT_OPTIMIZER
+          case   cPopNMov:
+              {
+                  unsigned stackOffs_target = byteCode[++IP];
+                  unsigned stackOffs_source = byteCode[++IP];
+                  Stack[stackOffs_target] = Stack[stackOffs_source];
+                  Deriv[stackOffs_target] = Deriv[stackOffs_source];
+                  SP = stackOffs_target;
+                  break;
+              }
+
+          case  cLog2by:
+              {
+                  const std::string log2 = symCall("log2", a);
+                  da = symAdd(symDiv(symMul(da, x), "(" + a + "*"
+                                     + symLiteral(fp_const_log2<Value_t>())
+                                     + ")"),
+                              symMul(log2, d));
+                  a = "(" + log2 + "*" + x + ")";
+                  --SP; break;
+              }
+
+          case cNop: break;
+#endif // FP_SUPPORT_OPTIMIZER
+
+          case cSinCos:
+              Names.define(x, SP);
+              Names.define(d, SP);
+              Deriv[SP+1] = symNeg(symMul(symCall("sin", x), d));
+              d = symMul(symCall("cos", x), d);
+              Stack[SP+1] = symCall("cos", x);
+              x = symCall("sin", x);
+              ++SP;
+              break;
+          case cSinhCosh:
+              Names.define(x, SP);
+              Names.define(d, SP);
+              Deriv[SP+1] = symMul(symCall("sinh", x), d);
+              d = symMul(symCall("cosh", x), d);
+              Stack[SP+1] = symCall("cosh", x);
+              x = symCall("sinh", x);
+              ++SP;
+              break;
+
+          case   cDup:
+              Names.define(x, SP);
+              Names.define(d, SP);
+              Stack[SP+1] = x; Deriv[SP+1] = d; ++SP; break;
+
+          case   cInv:
+              d = symNeg(symDiv(d, "(" + x + "^2)"));
+              x = "(1/" + x + ")";
+              break;
+
+          case   cSqr:
+              d = symMul("(2*" + x + ")", d);
+              x = "(" + x + "^2)";
+              break;
+
+          case   cRDiv:
+              da = symDiv(symSub(symMul(d, a), symMul(x, da)),
+                          "(" + a + "^2)");
+              a = "(" + x + "/" + a + ")";
+              --SP; break;
+
+          case   cRSub: da = symSub(d, da); a = "(" + x + "-" + a + ")";
+                        --SP; break;
+
+          case   cRSqrt:
+              d = symNeg(symDiv(d, "(2*" + x + "*" + symCall("sqrt", x) + ")"));
+              x = "(1/" + symCall("sqrt", x) + ")";
+              break;
+
+#ifdef FP_SUPPORT_COMPLEX_NUMBERS
+          case   cReal:
+              if(!d.empty()) d = symCall("real", d);
+              x = symCall("real", x); break;
+          case   cImag:
+              if(!d.empty()) d = symCall("imag", d);
+              x = symCall("imag", x); break;
+          case   cArg:
+              if(!d.empty()) d = symCall("imag", symDiv(d, x));
+              x = symCall("arg", x); break;
+          case   cConj:
+              if(!d.empty()) d = symCall("conj", d);
+              x = symCall("conj", x); break;
+          case   cPolar:
+              // d(r*e^(it)) = dr*e^(it) + r*dt*e^(i(t+pi/2))
+              da = symAdd
+                  (da.empty() ? da : symCall("polar", da, x),
+                   d.empty() ? d : symCall
+                   ("polar", symMul(a, d), "(" + x + "+"
+                    + symLiteral(fp_const_pi<Value_t>() / Value_t(2)) + ")"));
+              a = symCall("polar", a, x);
+              --SP; break;
+#endif
+
+
+// Variables:
+          default:
+              ++SP;
+              Stack[SP] = Vars[byteCode[IP]-VarBegin];
+              Deriv[SP] = VarDerivs[byteCode[IP]-VarBegin];
+        }
+    }
+
+    // The optimizer can leave values below the result
+    if(SP < 0 || !pendingIfs.empty()) return false;
+    Value = Stack[SP];
+    Derivative = Deriv[SP];
+    return true;
+}
+
+
 //===========================================================================
 // Variable deduction
 //===========================================================================
@@ -3513,6 +5480,9 @@ void FunctionParserBase<Value_t>::PrintByteCode(std::ostream& dest,
                       static std::string name;
                       name = "f:" + findName(mData->mNamePtrs, index,
                                              NameData<Value_t>::FUNC_PTR);
+                      if(name == "f:?")
+                          name = "f:" + findName(mData->mImportedNames, index,
+                                                 NameData<Value_t>::FUNC_PTR);
                       n = name.c_str();
                       out_params = true;
                       break;
@@ -3525,6 +5495,9 @@ void FunctionParserBase<Value_t>::PrintByteCode(std::ostream& dest,
                       static std::string name;
                       name = "p:" + findName(mData->mNamePtrs, index,
                                              NameData<Value_t>::PARSER_PTR);
+                      if(name == "p:?")
+                          name = "p:" + findName(mData->mImportedNames, index,
+                                                 NameData<Value_t>::PARSER_PTR);
                       n = name.c_str();
                       out_params = true;
                       break;
@@ -13,6 +13,8 @@
 
 #include <string>
 #include <vector>
+#include <cstddef>
+#include <atomic>
 
 #ifdef FUNCTIONPARSER_SUPPORT_DEBUGGING
 #include <iostream>
@@ -25,6 +27,14 @@
 #endif
 
 namespace FPoptimizer_CodeTree { template<typename Value_t> class CodeTree; }
+namespace FUNCTIONPARSERTYPES
+{
+    struct NamePtr;
+    template<typename Value_t> struct NameData;
+}
+class FunctionParserJIT;
+class FunctionParserInterval;
+template<typename> class FunctionParserArchive;
 
 template<typename Value_t>
 class FunctionParserBase
@@ -35,7 +45,7 @@ class FunctionParserBase
         SYNTAX_ERROR=0, MISM_PARENTH, MISSING_PARENTH, EMPTY_PARENTH,
         EXPECT_OPERATOR, OUT_OF_MEMORY, UNEXPECTED_ERROR, INVALID_VARS,
         ILL_PARAMS_AMOUNT, PREMATURE_EOS, EXPECT_PARENTH_FUNC,
-        UNKNOWN_IDENTIFIER,
+        UNKNOWN_IDENTIFIER, RECURSIVE_CALL,
         NO_FUNCTION_PARSED_YET,
         FP_NO_ERROR
     };
@@ -59,6 +69,37 @@ class FunctionParserBase
     Value_t Eval(const Value_t* Vars);
     int EvalError() const;
 
+    // Evaluates the function for 'count' consecutive sets of variables
+    // (Vars holds count * amount-of-variables values, one set after the
+    // other) and writes the results to Results. EvalError() reports the
+    // first error encountered; the failing entries are set to 0 as in Eval().
+    void EvalBatch(const Value_t* Vars, std::size_t count, Value_t* Results);
+
+    // The evaluation state (stacks and error code) can also be kept in an
+    // EvalContext, in which case evaluation does not modify the parser. Any
+    // number of threads can then evaluate the same parser simultaneously,
+    // each using its own EvalContext. The result of EvalError() is then
+    // found in the context instead.
+    class EvalContext;
+
+    Value_t Eval(EvalContext& context, const Value_t* Vars) const;
+    void EvalBatch(EvalContext& context, const Value_t* Vars,
+                   std::size_t count, Value_t* Results) const;
+
+    // Evaluates the function and, in the same pass, its derivative with
+    // respect to the variable number VarIndex (forward-mode automatic
+    // differentiation). Functions added with AddFunction(name, FunctionPtr)
+    // or as wrappers are differentiated numerically.
+    Value_t EvalWithDerivative(EvalContext& context, const Value_t* Vars,
+                               unsigned VarIndex, Value_t& Derivative) const;
+
+    // The same with the derivative along Direction (one value for every
+    // variable), that is the sum of the partial derivatives times Direction.
+    Value_t EvalWithDirectionalDerivative(EvalContext& context,
+                                          const Value_t* Vars,
+                                          const Value_t* Direction,
+                                          Value_t& Derivative) const;
+
     bool AddConstant(const std::string& name, Value_t value);
     bool AddUnit(const std::string& name, Value_t value);
 
@@ -78,8 +119,33 @@ class FunctionParserBase
 
     bool RemoveIdentifier(const std::string& name);
 
+    // A set of constants, units and functions made once from the
+    // identifiers of a parser, which any number of parsers can then be
+    // layered on. It's immutable and reference-counted: its copies, and the
+    // parsers using it, all share a single copy of the identifiers.
+    class SymbolTable;
+
+    // The identifiers which are not defined in this parser are looked up in
+    // Table by the next calls to Parse(). The parser's own identifiers form
+    // a small private overlay: they can shadow the names of the table, and
+    // adding or removing them doesn't affect the other users of the table.
+    // The functions of the table used by an expression stay in the parser,
+    // but the variables and functions added later can still take their
+    // names. A function parser of the table which calls this parser can't
+    // be used (RECURSIVE_CALL).
+    void UseSymbolTable(const SymbolTable& Table);
+
     void Optimize();
 
+    // Sets Result to a new parser which evaluates the derivative of this
+    // function with respect to the variable number VarIndex. The derivative
+    // is built symbolically and optimized, and it can be differentiated
+    // again. The values used more than once by the function (its inline
+    // variables, for example) are computed once by the derivative as well.
+    // Returns false (leaving Result unchanged) if the function uses
+    // C++ functions added with AddFunction(), whose derivative is unknown.
+    bool Differentiate(FunctionParserBase& Result, unsigned VarIndex) const;
+
 
     int ParseAndDeduceVariables(const std::string& function,
                                 int* amountOfVariablesFound = 0,
@@ -133,6 +199,9 @@ class FunctionParserBase
 //========================================================================
 
     friend class FPoptimizer_CodeTree::CodeTree<Value_t>;
+    friend class ::FunctionParserJIT;
+    friend class ::FunctionParserInterval;
+    friend class ::FunctionParserArchive<Value_t>;
 
 // Private data:
 // ------------
@@ -145,6 +214,8 @@ class FunctionParserBase
     void CopyOnWrite();
     bool CheckRecursiveLinking(const FunctionParserBase*) const;
     bool NameExists(const char*, unsigned);
+    const FUNCTIONPARSERTYPES::NameData<Value_t>*
+    FindName(const FUNCTIONPARSERTYPES::NamePtr&, bool* recursive = 0);
     bool ParseVariables(const std::string&);
     int ParseFunction(const char*, bool);
     const char* SetErrorType(ParseErrorType, const char*);
@@ -174,6 +245,18 @@ class FunctionParserBase
     template<bool SetFlag>
     inline void PutOpcodeParamAt(unsigned, unsigned offset);
     const char* Compile(const char*);
+    Value_t EvalWithStack(const Value_t*, Value_t*, EvalContext*, int&) const;
+    Value_t EvalDualWithStack(const Value_t*, const Value_t*, Value_t*,
+                              Value_t*, EvalContext&, int&, Value_t&) const;
+    struct SymbolicNames;
+    bool DifferentiateByteCode(const std::vector<std::string>&,
+                               const std::vector<std::string>&,
+                               std::string&, std::string&,
+                               SymbolicNames&) const;
+    bool EvalBatchBlock(const Value_t*, unsigned, Value_t*, Value_t*,
+                        EvalContext*) const;
+    void EvalBatchWithStacks(const Value_t*, std::size_t, Value_t*,
+                             Value_t*, Value_t*, EvalContext*, int&) const;
 
     bool addFunctionWrapperPtr(const std::string&, FunctionWrapper*, unsigned);
     static void incFuncWrapperRefCount(FunctionWrapper*);
@@ -200,7 +283,9 @@ class FunctionParser_cld: public FunctionParserBase<std::complex<long double> >
 template<typename Value_t>
 class FunctionParserBase<Value_t>::FunctionWrapper
 {
-    unsigned mReferenceCount;
+    // Atomic because the parsers sharing a SymbolTable, in any thread,
+    // take a reference when they import the function
+    std::atomic<unsigned> mReferenceCount;
     friend class FunctionParserBase<Value_t>;
 
  public:
@@ -212,6 +297,44 @@ class FunctionParserBase<Value_t>::FunctionWrapper
     virtual Value_t callFunction(const Value_t*) = 0;
 };
 
+template<typename Value_t>
+class FunctionParserBase<Value_t>::EvalContext
+{
+    std::vector<Value_t> mStack, mBatchStack;
+    std::vector<Value_t> mDerivativeStack, mDerivativeSeeds, mFunctionArguments;
+    std::vector<EvalContext> mNestedContexts;
+    int mEvalErrorType;
+    friend class FunctionParserBase<Value_t>;
+
+    // Contexts for the parsers called by this one (cPCall), by index
+    EvalContext& NestedContext(unsigned index)
+    {
+        if(mNestedContexts.size() <= index) mNestedContexts.resize(index + 1);
+        return mNestedContexts[index];
+    }
+
+ public:
+    EvalContext(): mEvalErrorType(0) {}
+
+    int EvalError() const { return mEvalErrorType; }
+};
+
+template<typename Value_t>
+class FunctionParserBase<Value_t>::SymbolTable
+{
+    Data* mData; // shared with the parser it was made of, 0 when empty
+    friend class FunctionParserBase<Value_t>;
+
+ public:
+    SymbolTable();
+    // The constants, units and functions of Symbols (not its variables) as
+    // they are now: later changes to Symbols don't affect the table.
+    explicit SymbolTable(const FunctionParserBase& Symbols);
+    SymbolTable(const SymbolTable&);
+    SymbolTable& operator=(const SymbolTable&);
+    ~SymbolTable();
+};
+
 template<typename Value_t>
 template<typename DerivedWrapper>
 bool FunctionParserBase<Value_t>::AddFunctionWrapper
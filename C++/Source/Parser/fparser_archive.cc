@@ -0,0 +1,698 @@
+/***************************************************************************\
+|* Function Parser for C++ v4.5.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Binary files of compiled functions                                      *|
+\***************************************************************************/
+
+#include "fpconfig.hh"
+#include "fparser_archive.hh"
+
+#include <cstdio>
+#include <cstring>
+
+#include "extrasrc/fptypes.hh"
+#include "extrasrc/fpaux.hh"
+using namespace FUNCTIONPARSERTYPES;
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* File format (all the numbers in the byte order of the writer):
+
+     char[8]   "fparser" magic string
+     uint32    format version
+     uint32    0x01020304, to detect the byte order
+     uint32    sizeof(Value_t)
+     uint32    kind of Value_t (1 = integer, 2 = complex)
+     uint32    number of functions
+     uint32    VarBegin, the number of opcodes (FP_SUPPORT_OPTIMIZER adds
+               some), which the variables of the bytecode are numbered from
+     uint64    offset of each function from the beginning of the file
+
+   and every function, 8-byte aligned:
+
+     EntryHeader
+     char      name of the function in the archive
+     char      variables string
+     Value_t   immediate values (mImmed)
+     uint32    bytecode (mByteCode), the indices of cFCall and cPCall
+               replaced by indices in the table below
+     for every user-defined function called:
+         uint32    kind (0 = FunctionPtr or FunctionWrapper, 1 = parser)
+         uint32    number of parameters
+         uint32    length of the name
+         char      name
+*/
+namespace
+{
+    const char Magic[8] = "fparser";
+    const unsigned FormatVersion = 2;
+    const unsigned ByteOrderMark = 0x01020304;
+    const std::size_t FileHeaderSize = 32;
+
+    struct EntryHeader
+    {
+        unsigned nameLength, varsLength, flags, variablesAmount;
+        unsigned stackSize, byteCodeSize, immedSize, functionsAmount;
+    };
+
+    enum { UseDegreesFlag = 1 };
+    enum { FunctionPtrKind = 0, ParserPtrKind = 1 };
+
+    template<typename Value_t>
+    unsigned ValueKind()
+    {
+        return (IsIntType<Value_t>::result ? 1 : 0) |
+            (IsComplexType<Value_t>::result ? 2 : 0);
+    }
+
+    // Number of parameters that follow an opcode in the bytecode
+    unsigned OpcodeParams(unsigned opcode)
+    {
+        switch(opcode)
+        {
+          case cIf: case cAbsIf: case cJump:
+              return 2;
+#ifdef FP_SUPPORT_OPTIMIZER
+          case cPopNMov:
+              return 2;
+#endif
+          case cFetch: case cFCall: case cPCall:
+              return 1;
+          default:
+              return 0;
+        }
+    }
+
+    /* Follows the stack pointer and the immediate pointer along every path
+       of the bytecode, as EvalWithStack() moves them, so that a damaged file
+       can't make the evaluation read or write outside of its buffers. Fails
+       unless every variable, immediate, stack offset and jump target is in
+       range, the branches meet with the same pointers and the function
+       leaves a value on the stack (the inline variables stay below the
+       result, which is on top). The jumps of the parser and of the
+       optimizer only go forward, and the others are rejected.
+       functionParams are the numbers of parameters of the table of the
+       user-defined functions, depth receives the stack size needed.
+    */
+    template<typename Value_t>
+    bool VerifyByteCode(const std::vector<unsigned>& byteCode,
+                        std::size_t immedSize, unsigned variablesAmount,
+                        const std::vector<unsigned>& functionParams,
+                        unsigned& depth)
+    {
+        const std::size_t size = byteCode.size();
+        // SP and DP of the jumps to every position, -2 when there are none
+        std::vector<int> jumpSP(size + 1, -2);
+        std::vector<unsigned> jumpDP(size + 1, 0);
+        int SP = -1;
+        unsigned DP = 0;
+        bool reachable = true;
+        depth = 0;
+
+        for(std::size_t IP = 0; ; ++IP)
+        {
+            if(jumpSP[IP] != -2)
+            {
+                if(reachable && (SP != jumpSP[IP] || DP != jumpDP[IP]))
+                    return false;
+                SP = jumpSP[IP];
+                DP = jumpDP[IP];
+                reachable = true;
+            }
+            if(IP == size) return reachable && SP >= 0;
+
+            const unsigned opcode = byteCode[IP];
+            const unsigned params = OpcodeParams(opcode);
+            if(IP + params >= size) return false;
+            for(unsigned i = 1; i <= params; ++i)
+                if(jumpSP[IP + i] != -2) return false;
+            if(!reachable) { IP += params; continue; }
+
+            // operands needed and values added (negative when removed)
+            unsigned needed = 0;
+            int pushed = 0;
+            switch(opcode)
+            {
+              case cAbs: case cAcos: case cAcosh: case cAsin: case cAsinh:
+              case cAtan: case cAtanh: case cCbrt: case cCeil: case cCos:
+              case cCosh: case cCot: case cCsc: case cExp: case cExp2:
+              case cFloor: case cInt: case cLog: case cLog10: case cLog2:
+              case cSec: case cSin: case cSinh: case cSqrt: case cTan:
+              case cTanh: case cTrunc: case cNeg: case cNot: case cNotNot:
+              case cDeg: case cRad: case cAbsNot: case cAbsNotNot:
+              case cInv: case cSqr: case cRSqrt:
+                  needed = 1;
+                  break;
+
+              case cAtan2: case cHypot: case cMax: case cMin: case cPow:
+              case cAdd: case cSub: case cMul: case cDiv: case cMod:
+              case cEqual: case cNEqual: case cLess: case cLessOrEq:
+              case cGreater: case cGreaterOrEq: case cAnd: case cOr:
+              case cAbsAnd: case cAbsOr: case cRDiv: case cRSub:
+#ifdef FP_SUPPORT_OPTIMIZER
+              case cLog2by:
+#endif
+                  needed = 2; pushed = -1;
+                  break;
+
+              case cReal: case cImag: case cArg: case cConj: case cPolar:
+                  if(!IsComplexType<Value_t>::result) return false;
+                  needed = opcode == cPolar ? 2 : 1;
+                  pushed = opcode == cPolar ? -1 : 0;
+                  break;
+
+              case cImmed:
+                  if(DP >= immedSize) return false;
+                  ++DP; pushed = 1;
+                  break;
+
+              case cDup: case cSinCos: case cSinhCosh:
+                  needed = 1; pushed = 1;
+                  break;
+
+              case cFetch:
+                  if(byteCode[IP + 1] >= size || int(byteCode[IP + 1]) > SP)
+                      return false;
+                  pushed = 1;
+                  break;
+
+              case cFCall: case cPCall:
+                  if(byteCode[IP + 1] >= functionParams.size()) return false;
+                  needed = functionParams[byteCode[IP + 1]];
+                  pushed = 1 - int(needed);
+                  break;
+
+#ifdef FP_SUPPORT_OPTIMIZER
+              case cPopNMov:
+                  if(byteCode[IP + 1] >= size || byteCode[IP + 2] >= size ||
+                     int(byteCode[IP + 1]) > SP || int(byteCode[IP + 2]) > SP)
+                      return false;
+                  pushed = int(byteCode[IP + 1]) - SP;
+                  break;
+
+              case cNop:
+                  break;
+#endif
+
+              case cIf: case cAbsIf: case cJump:
+                  if(opcode != cJump) { needed = 1; pushed = -1; }
+                  break;
+
+              default:
+                  if(opcode < VarBegin || opcode - VarBegin >= variablesAmount)
+                      return false;
+                  pushed = 1;
+            }
+
+            if(unsigned(SP + 1) < needed) return false;
+            SP += pushed;
+            if(unsigned(SP + 1) > depth) depth = unsigned(SP + 1);
+
+            if(opcode == cIf || opcode == cAbsIf || opcode == cJump)
+            {
+                // the execution goes on after the position of the jump
+                const unsigned target = byteCode[IP + 1];
+                if(target < IP + params || target >= size ||
+                   byteCode[IP + 2] > immedSize)
+                    return false;
+                int& targetSP = jumpSP[target + 1];
+                unsigned& targetDP = jumpDP[target + 1];
+                if(targetSP == -2)
+                {
+                    targetSP = SP;
+                    targetDP = byteCode[IP + 2];
+                }
+                else if(targetSP != SP || targetDP != byteCode[IP + 2])
+                    return false;
+                reachable = opcode != cJump;
+            }
+            IP += params;
+        }
+    }
+
+    template<typename Value_t>
+    bool FindFunctionName(const NamePtrsMap<Value_t>& names,
+                          typename NameData<Value_t>::DataType type,
+                          unsigned index, NamePtr& name)
+    {
+        for(typename NamePtrsMap<Value_t>::const_iterator i = names.begin();
+            i != names.end(); ++i)
+            if(i->second.type == type && i->second.index == index)
+            {
+                name = i->first;
+                return true;
+            }
+        return false;
+    }
+
+    void Append(std::vector<unsigned char>& out, const void* data,
+                std::size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        out.insert(out.end(), bytes, bytes + size);
+    }
+
+    void AppendUnsigned(std::vector<unsigned char>& out, unsigned value)
+    {
+        Append(out, &value, sizeof(value));
+    }
+
+    // Bounds-checked reading of an entry of the mapped file
+    class Reader
+    {
+     public:
+        Reader(const unsigned char* begin, std::size_t size):
+            mPtr(begin), mEnd(begin + size)
+        {}
+
+        const unsigned char* Skip(std::size_t size)
+        {
+            if(size > std::size_t(mEnd - mPtr)) return 0;
+            const unsigned char* result = mPtr;
+            mPtr += size;
+            return result;
+        }
+
+        bool Read(void* out, std::size_t size)
+        {
+            const unsigned char* data = Skip(size);
+            if(!data) return false;
+            if(size) std::memcpy(out, data, size);
+            return true;
+        }
+
+     private:
+        const unsigned char* mPtr;
+        const unsigned char* mEnd;
+    };
+}
+
+
+//=========================================================================
+// Writing
+//=========================================================================
+template<typename Value_t>
+FunctionParserArchive<Value_t>::FunctionParserArchive():
+    mMapping(0), mMappingSize(0)
+{}
+
+template<typename Value_t>
+FunctionParserArchive<Value_t>::~FunctionParserArchive()
+{
+    Close();
+}
+
+template<typename Value_t>
+bool FunctionParserArchive<Value_t>::Add
+(const std::string& Name, const FunctionParserBase<Value_t>& parser)
+{
+    typedef typename FunctionParserBase<Value_t>::Data Data;
+    const Data& data = *parser.mData;
+    if(data.mParseErrorType != FunctionParserBase<Value_t>::FP_NO_ERROR)
+        return false;
+
+    // The table of the user-defined functions called, in order of appearance
+    std::vector<unsigned> byteCode = data.mByteCode;
+    std::vector<std::pair<unsigned, unsigned> > called; // kind, index
+    for(std::size_t IP = 0; IP < byteCode.size(); ++IP)
+    {
+        const unsigned opcode = byteCode[IP];
+        if(opcode == cFCall || opcode == cPCall)
+        {
+            const std::pair<unsigned, unsigned> function
+                (opcode == cFCall ? unsigned(FunctionPtrKind)
+                                  : unsigned(ParserPtrKind),
+                 byteCode[IP + 1]);
+            unsigned position = 0;
+            while(position < called.size() && called[position] != function)
+                ++position;
+            if(position == called.size()) called.push_back(function);
+            byteCode[IP + 1] = position;
+        }
+        IP += OpcodeParams(opcode);
+    }
+
+    std::vector<unsigned char> entry;
+    EntryHeader header;
+    header.nameLength = unsigned(Name.size());
+    header.varsLength = unsigned(data.mVariablesString.size());
+    header.flags = data.mUseDegreeConversion ? unsigned(UseDegreesFlag) : 0;
+    header.variablesAmount = data.mVariablesAmount;
+    header.stackSize = data.mStackSize;
+    header.byteCodeSize = unsigned(byteCode.size());
+    header.immedSize = unsigned(data.mImmed.size());
+    header.functionsAmount = unsigned(called.size());
+    Append(entry, &header, sizeof(header));
+    Append(entry, Name.data(), Name.size());
+    Append(entry, data.mVariablesString.data(), data.mVariablesString.size());
+    if(!data.mImmed.empty())
+        Append(entry, &data.mImmed[0], data.mImmed.size() * sizeof(Value_t));
+    if(!byteCode.empty())
+        Append(entry, &byteCode[0], byteCode.size() * sizeof(unsigned));
+
+    for(std::size_t i = 0; i < called.size(); ++i)
+    {
+        const typename NameData<Value_t>::DataType type =
+            called[i].first == FunctionPtrKind ?
+            NameData<Value_t>::FUNC_PTR : NameData<Value_t>::PARSER_PTR;
+        const unsigned params = called[i].first == FunctionPtrKind ?
+            data.mFuncPtrs[called[i].second].mParams :
+            data.mFuncParsers[called[i].second].mParams;
+
+        // The functions imported from a symbol table have their own names
+        NamePtr name;
+        if(!FindFunctionName(data.mNamePtrs, type, called[i].second, name) &&
+           !FindFunctionName(data.mImportedNames, type, called[i].second,
+                             name))
+            return false;
+
+        AppendUnsigned(entry, called[i].first);
+        AppendUnsigned(entry, params);
+        AppendUnsigned(entry, name.nameLength);
+        Append(entry, name.name, name.nameLength);
+    }
+
+    entry.resize((entry.size() + 7) & ~std::size_t(7), 0);
+
+    mPending.push_back(std::vector<unsigned char>());
+    mPending.back().swap(entry);
+    return true;
+}
+
+template<typename Value_t>
+bool FunctionParserArchive<Value_t>::Save(const std::string& FileName) const
+{
+    std::vector<unsigned char> header;
+    Append(header, Magic, sizeof(Magic));
+    AppendUnsigned(header, FormatVersion);
+    AppendUnsigned(header, ByteOrderMark);
+    AppendUnsigned(header, unsigned(sizeof(Value_t)));
+    AppendUnsigned(header, ValueKind<Value_t>());
+    AppendUnsigned(header, unsigned(mPending.size()));
+    AppendUnsigned(header, unsigned(VarBegin));
+
+    unsigned long long offset = FileHeaderSize + 8 * mPending.size();
+    for(std::size_t i = 0; i < mPending.size(); ++i)
+    {
+        Append(header, &offset, 8);
+        offset += mPending[i].size();
+    }
+
+    std::FILE* file = std::fopen(FileName.c_str(), "wb");
+    if(!file) return false;
+    bool success =
+        std::fwrite(&header[0], 1, header.size(), file) == header.size();
+    for(std::size_t i = 0; success && i < mPending.size(); ++i)
+        success = std::fwrite(&mPending[i][0], 1, mPending[i].size(), file)
+            == mPending[i].size();
+    return std::fclose(file) == 0 && success;
+}
+
+template<typename Value_t>
+void FunctionParserArchive<Value_t>::Clear()
+{
+    mPending.clear();
+}
+
+
+//=========================================================================
+// Reading
+//=========================================================================
+template<typename Value_t>
+bool FunctionParserArchive<Value_t>::Open(const std::string& FileName)
+{
+    Close();
+
+    // The view of the file stays valid after its handles are closed
+#ifdef _WIN32
+    HANDLE file = CreateFileA(FileName.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ, 0, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, 0);
+    if(file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = 0;
+    if(GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0)
+        mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    if(mapping)
+    {
+        mMapping = static_cast<const unsigned char*>
+            (MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        mMappingSize = std::size_t(fileSize.QuadPart);
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+#else
+    const int file = open(FileName.c_str(), O_RDONLY);
+    if(file < 0) return false;
+    struct stat status;
+    if(fstat(file, &status) == 0 && status.st_size > 0)
+    {
+        void* mapping = mmap(0, std::size_t(status.st_size), PROT_READ,
+                             MAP_SHARED, file, 0);
+        if(mapping != MAP_FAILED)
+        {
+            mMapping = static_cast<const unsigned char*>(mapping);
+            mMappingSize = std::size_t(status.st_size);
+        }
+    }
+    close(file);
+#endif
+    if(!mMapping) { mMappingSize = 0; return false; }
+
+    Reader reader(mMapping, mMappingSize);
+    char magic[8];
+    unsigned version, byteOrder, valueSize, valueKind, count, opcodes;
+    if(!reader.Read(magic, sizeof(magic)) ||
+       std::memcmp(magic, Magic, sizeof(Magic)) != 0 ||
+       !reader.Read(&version, 4) || version != FormatVersion ||
+       !reader.Read(&byteOrder, 4) || byteOrder != ByteOrderMark ||
+       !reader.Read(&valueSize, 4) || valueSize != sizeof(Value_t) ||
+       !reader.Read(&valueKind, 4) || valueKind != ValueKind<Value_t>() ||
+       !reader.Read(&count, 4) ||
+       !reader.Read(&opcodes, 4) || opcodes != unsigned(VarBegin))
+    {
+        Close();
+        return false;
+    }
+
+    mEntries.reserve(count);
+    for(unsigned i = 0; i < count; ++i)
+    {
+        unsigned long long offset;
+        EntryHeader header;
+        if(!reader.Read(&offset, 8) || offset >= mMappingSize)
+        {
+            Close();
+            return false;
+        }
+        const Entry entry = { mMapping + offset,
+                              mMappingSize - std::size_t(offset) };
+        Reader entryReader(entry.begin, entry.size);
+        const unsigned char* name = 0;
+        if(!entryReader.Read(&header, sizeof(header)) ||
+           !(name = entryReader.Skip(header.nameLength)))
+        {
+            Close();
+            return false;
+        }
+        mEntries.push_back(entry);
+        mIndex.insert(std::make_pair
+                      (std::string(reinterpret_cast<const char*>(name),
+                                   header.nameLength), i));
+    }
+    return true;
+}
+
+template<typename Value_t>
+void FunctionParserArchive<Value_t>::Close()
+{
+    if(mMapping)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(mMapping);
+#else
+        munmap(const_cast<unsigned char*>(mMapping), mMappingSize);
+#endif
+    }
+    mMapping = 0;
+    mMappingSize = 0;
+    mEntries.clear();
+    mIndex.clear();
+}
+
+template<typename Value_t>
+std::string FunctionParserArchive<Value_t>::Name(unsigned Index) const
+{
+    if(Index >= mEntries.size()) return std::string();
+    const unsigned char* name =
+        mEntries[Index].begin + sizeof(EntryHeader);
+    EntryHeader header;
+    std::memcpy(&header, mEntries[Index].begin, sizeof(header));
+    return std::string(reinterpret_cast<const char*>(name),
+                       header.nameLength);
+}
+
+template<typename Value_t>
+int FunctionParserArchive<Value_t>::Find(const std::string& Name) const
+{
+    std::unordered_map<std::string, unsigned>::const_iterator found =
+        mIndex.find(Name);
+    return found == mIndex.end() ? -1 : int(found->second);
+}
+
+template<typename Value_t>
+bool FunctionParserArchive<Value_t>::Load
+(const std::string& Name, FunctionParserBase<Value_t>& Result) const
+{
+    const int index = Find(Name);
+    return index >= 0 && Load(unsigned(index), Result);
+}
+
+template<typename Value_t>
+bool FunctionParserArchive<Value_t>::Load
+(unsigned Index, FunctionParserBase<Value_t>& Result) const
+{
+    typedef typename FunctionParserBase<Value_t>::Data Data;
+    if(Index >= mEntries.size()) return false;
+
+    Reader reader(mEntries[Index].begin, mEntries[Index].size);
+    EntryHeader header;
+    const unsigned char* vars = 0;
+    if(!reader.Read(&header, sizeof(header)) ||
+       !reader.Skip(header.nameLength) ||
+       !(vars = reader.Skip(header.varsLength)) ||
+       header.immedSize > mEntries[Index].size / sizeof(Value_t) ||
+       header.byteCodeSize > mEntries[Index].size / sizeof(unsigned))
+        return false;
+
+    std::vector<Value_t> immed(header.immedSize);
+    std::vector<unsigned> byteCode(header.byteCodeSize);
+    if(!reader.Read(immed.empty() ? 0 : &immed[0],
+                    immed.size() * sizeof(Value_t)) ||
+       !reader.Read(byteCode.empty() ? 0 : &byteCode[0],
+                    byteCode.size() * sizeof(unsigned)))
+        return false;
+
+    // The user-defined functions are looked up by name in Result (and in
+    // its symbol table, from which they are then imported)
+    Result.CopyOnWrite();
+    const Data& data = *Result.mData;
+    std::vector<unsigned> functionKind, functionIndex, functionParams;
+    for(unsigned i = 0; i < header.functionsAmount; ++i)
+    {
+        unsigned kind, params, nameLength;
+        const unsigned char* name = 0;
+        if(!reader.Read(&kind, 4) || !reader.Read(&params, 4) ||
+           !reader.Read(&nameLength, 4) ||
+           !(name = reader.Skip(nameLength)))
+            return false;
+
+        const NameData<Value_t>* found = Result.FindName
+            (NamePtr(reinterpret_cast<const char*>(name), nameLength));
+        if(!found) return false;
+        if(kind == FunctionPtrKind)
+        {
+            if(found->type != NameData<Value_t>::FUNC_PTR ||
+               data.mFuncPtrs[found->index].mParams != params)
+                return false;
+        }
+        else if(found->type != NameData<Value_t>::PARSER_PTR ||
+                data.mFuncParsers[found->index].mParams != params)
+            return false;
+        functionKind.push_back(kind);
+        functionIndex.push_back(found->index);
+        functionParams.push_back(params);
+    }
+
+    // The stack size saved by the parser may be larger than needed, but not
+    // smaller; the one verified is used, so that a damaged file can't make
+    // the parser allocate any amount of memory
+    unsigned depth = 0;
+    if(!VerifyByteCode<Value_t>(byteCode, immed.size(),
+                                header.variablesAmount, functionParams,
+                                depth) ||
+       header.stackSize < depth)
+        return false;
+
+    for(std::size_t IP = 0; IP < byteCode.size(); ++IP)
+    {
+        const unsigned opcode = byteCode[IP];
+        const unsigned params = OpcodeParams(opcode);
+        if(IP + params >= byteCode.size()) return false;
+        if(opcode == cFCall || opcode == cPCall)
+        {
+            const unsigned function = byteCode[IP + 1];
+            if(function >= functionIndex.size() ||
+               functionKind[function] !=
+               (opcode == cFCall ? unsigned(FunctionPtrKind)
+                                 : unsigned(ParserPtrKind)))
+                return false;
+            byteCode[IP + 1] = functionIndex[function];
+        }
+        IP += params;
+    }
+
+    // The variables string must declare as many variables as the bytecode
+    // was verified with; Result is left without a function otherwise
+    Data& newData = *Result.mData;
+    if(!Result.ParseVariables
+       (std::string(reinterpret_cast<const char*>(vars), header.varsLength))
+       || newData.mVariablesAmount != header.variablesAmount)
+    {
+        newData.mParseErrorType = FunctionParserBase<Value_t>::INVALID_VARS;
+        return false;
+    }
+
+    newData.mParseErrorType = FunctionParserBase<Value_t>::FP_NO_ERROR;
+    newData.mEvalErrorType = 0;
+    newData.mUseDegreeConversion = (header.flags & UseDegreesFlag) != 0;
+    newData.mHasByteCodeFlags = false;
+    newData.mVariablesAmount = header.variablesAmount;
+    newData.mInlineVarNames.clear();
+    newData.mByteCode.swap(byteCode);
+    newData.mImmed.swap(immed);
+    newData.mStackSize = depth;
+#ifndef FP_USE_THREAD_SAFE_EVAL
+    newData.mStack.resize(newData.mStackSize);
+#endif
+    return true;
+}
+
+
+#define FUNCTIONPARSER_INSTANTIATE_ARCHIVE(type) \
+    template class FunctionParserArchive< type >;
+
+#ifndef FP_DISABLE_DOUBLE_TYPE
+FUNCTIONPARSER_INSTANTIATE_ARCHIVE(double)
+#endif
+
+#ifdef FP_SUPPORT_FLOAT_TYPE
+FUNCTIONPARSER_INSTANTIATE_ARCHIVE(float)
+#endif
+
+#ifdef FP_SUPPORT_LONG_DOUBLE_TYPE
+FUNCTIONPARSER_INSTANTIATE_ARCHIVE(long double)
+#endif
+
+#ifdef FP_SUPPORT_LONG_INT_TYPE
+FUNCTIONPARSER_INSTANTIATE_ARCHIVE(long)
+#endif
+
+#ifdef FP_SUPPORT_COMPLEX_DOUBLE_TYPE
+FUNCTIONPARSER_INSTANTIATE_ARCHIVE(std::complex<double>)
+#endif
+
+#ifdef FP_SUPPORT_COMPLEX_FLOAT_TYPE
+FUNCTIONPARSER_INSTANTIATE_ARCHIVE(std::complex<float>)
+#endif
+
+#ifdef FP_SUPPORT_COMPLEX_LONG_DOUBLE_TYPE
+FUNCTIONPARSER_INSTANTIATE_ARCHIVE(std::complex<long double>)
+#endif
@@ -0,0 +1,86 @@
+/***************************************************************************\
+|* Function Parser for C++ v4.5.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Binary files of compiled functions                                      *|
+\***************************************************************************/
+
+#ifndef ONCE_FPARSER_ARCHIVE_H_
+#define ONCE_FPARSER_ARCHIVE_H_
+
+#include "fparser.hh"
+#include <string>
+#include <vector>
+#include <cstddef>
+#include <unordered_map>
+
+/* Saves the bytecode of parsed (and usually optimized) functions to a file,
+   and loads it back into parsers without parsing or optimizing anything.
+
+   A file holds any number of named functions. Open() maps it in memory and
+   Load() copies the bytecode, the constants and the stack size of a single
+   function into a parser, so opening a file with thousands of functions
+   costs about as much as reading their names.
+
+   The user-defined functions (AddFunction()) called by a saved function are
+   stored by name and number of parameters: the parser given to Load() must
+   already have functions with the same names and numbers of parameters,
+   otherwise Load() fails. The user-defined constants and units are part of
+   the bytecode and don't need to be defined again.
+
+   The format is versioned and stores the size of Value_t, the byte order
+   of the machine that wrote it and the number of opcodes, which depends on
+   the configuration of the library; Open() rejects the files that can't be
+   read as they are. Load() follows the stack along every path of the
+   bytecode and fails unless every variable, constant, stack offset and
+   jump is in range, so a damaged file can't make Eval() crash. Not
+   available for MpfrFloat and GmpInt, whose values can't be copied as
+   bytes.
+*/
+template<typename Value_t>
+class FunctionParserArchive
+{
+ public:
+    FunctionParserArchive();
+    ~FunctionParserArchive();
+
+    // Writing: the functions added are saved all together by Save().
+    // Add() fails when the parser has not parsed a function successfully.
+    bool Add(const std::string& Name, const FunctionParserBase<Value_t>&);
+    bool Save(const std::string& FileName) const;
+    void Clear();
+
+    // Reading: the members below refer to the file opened last.
+    bool Open(const std::string& FileName);
+    void Close();
+
+    unsigned Size() const { return unsigned(mEntries.size()); }
+    std::string Name(unsigned Index) const;
+    int Find(const std::string& Name) const; // -1 when not found
+
+    // Result keeps its own functions, constants and delimiter character
+    bool Load(unsigned Index, FunctionParserBase<Value_t>& Result) const;
+    bool Load(const std::string& Name,
+              FunctionParserBase<Value_t>& Result) const;
+
+
+//========================================================================
+ private:
+//========================================================================
+    struct Entry
+    {
+        const unsigned char* begin;
+        std::size_t size;
+    };
+
+    std::vector<std::vector<unsigned char> > mPending;
+
+    const unsigned char* mMapping;
+    std::size_t mMappingSize;
+    std::vector<Entry> mEntries;
+    std::unordered_map<std::string, unsigned> mIndex;
+
+    FunctionParserArchive(const FunctionParserArchive&); // not implemented on purpose
+    FunctionParserArchive& operator=(const FunctionParserArchive&); // ditto
+};
+
+#endif
@@ -0,0 +1,203 @@
+/***************************************************************************\
+|* Function Parser for C++ v4.5.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Process-wide cache of parsed functions                                  *|
+\***************************************************************************/
+
+#ifndef ONCE_FPARSER_CACHE_H_
+#define ONCE_FPARSER_CACHE_H_
+
+#include "fparser.hh"
+#include <list>
+#include <mutex>
+#include <string>
+#include <cstddef>
+#include <unordered_map>
+
+/* A size-bounded LRU cache of parsed (and optionally optimized) functions.
+   Parsing the same function again only copies a parser, which shares the
+   bytecode with the cached one through the copy-on-write data of
+   FunctionParserBase: nothing is tokenized, looked up or optimized.
+
+   The key is the function with the whitespace between tokens removed, the
+   variables, the degree mode and whether the bytecode is optimized; every
+   value type has its own cache (global()). Only the functions parsed
+   without errors are stored.
+
+   The parsers given by the cache know only the default functions and
+   constants: the ones added with AddConstant(), AddFunction() and so on
+   are not part of the key, so a parser using them must not be cached.
+   All the members can be called by several threads simultaneously. The
+   copies share their data, so when they are evaluated by several threads
+   the Eval() overloads with an EvalContext must be used.
+*/
+template<typename Value_t>
+class FunctionParserCache
+{
+ public:
+    explicit FunctionParserCache(std::size_t capacity = 256):
+        mCapacity(capacity), mHits(0), mMisses(0)
+    {}
+
+    // The cache used by default, one per value type
+    static FunctionParserCache& global()
+    {
+        static FunctionParserCache cache;
+        return cache;
+    }
+
+    // Sets Result to the parsed function, like Result.Parse() followed by
+    // Result.Optimize() when Optimize is true, and returns the same value
+    // of Parse(): -1 on success, the position of the error otherwise.
+    int Parse(FunctionParserBase<Value_t>& Result, const std::string& Function,
+              const std::string& Vars, bool useDegrees = false,
+              bool Optimize = true)
+    {
+        const std::string key =
+            Normalize(Function) + '\0' + Normalize(Vars) + '\0' +
+            (useDegrees ? 'd' : 'r') + (Optimize ? 'o' : 'p');
+
+        {
+            std::lock_guard<std::mutex> guard(mLock);
+            typename Index::iterator found = mIndex.find(key);
+            if(found != mIndex.end())
+            {
+                ++mHits;
+                mEntries.splice(mEntries.begin(), mEntries, found->second);
+                Result = found->second->second;
+                return -1;
+            }
+            ++mMisses;
+        }
+
+        // The slow part runs outside of the lock
+        FunctionParserBase<Value_t> parser;
+        const int result = parser.Parse(Function, Vars, useDegrees);
+        if(result >= 0)
+        {
+            Result = parser;
+            return result;
+        }
+        if(Optimize) parser.Optimize();
+
+        std::lock_guard<std::mutex> guard(mLock);
+        typename Index::iterator found = mIndex.find(key);
+        if(found == mIndex.end() && mCapacity > 0)
+        {
+            mEntries.push_front(Entry(key, parser));
+            mIndex[key] = mEntries.begin();
+            Evict();
+        }
+        Result = parser;
+        return -1;
+    }
+
+    void SetCapacity(std::size_t capacity)
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mCapacity = capacity;
+        Evict();
+    }
+
+    std::size_t Capacity() const
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        return mCapacity;
+    }
+
+    std::size_t Size() const
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        return mEntries.size();
+    }
+
+    std::size_t Hits() const
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        return mHits;
+    }
+
+    std::size_t Misses() const
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        return mMisses;
+    }
+
+    void Clear()
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mIndex.clear();
+        mEntries.clear();
+    }
+
+
+//========================================================================
+ private:
+//========================================================================
+    typedef std::pair<std::string, FunctionParserBase<Value_t> > Entry;
+    typedef std::list<Entry> Entries;
+    typedef std::unordered_map<std::string,
+                               typename Entries::iterator> Index;
+
+    mutable std::mutex mLock;
+    std::size_t mCapacity, mHits, mMisses;
+    Entries mEntries; // the most recently used first
+    Index mIndex;
+
+    void Evict()
+    {
+        while(mEntries.size() > mCapacity)
+        {
+            mIndex.erase(mEntries.back().first);
+            mEntries.pop_back();
+        }
+    }
+
+    // Removes the whitespace, except a single space between two characters
+    // of names or numbers ("2 3" and "23" are not the same function) and
+    // between two operator characters ("< =" is not "<=").
+    enum CharClass { NameChar, Bracket, OperatorChar };
+
+    static CharClass ClassOf(unsigned char c)
+    {
+        if((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_' || c == '.' || c >= 0x80)
+            return NameChar;
+        if(c == '(' || c == ')' || c == '[' || c == ']' || c == ',')
+            return Bracket;
+        return OperatorChar;
+    }
+
+    static bool IsSpace(unsigned char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' ||
+            c == '\v' || c == '\f';
+    }
+
+    static std::string Normalize(const std::string& text)
+    {
+        std::string result;
+        result.reserve(text.size());
+        bool pendingSpace = false;
+        for(std::size_t i = 0; i < text.size(); ++i)
+        {
+            const unsigned char c = text[i];
+            if(IsSpace(c)) { pendingSpace = true; continue; }
+            if(pendingSpace && !result.empty())
+            {
+                const CharClass previous =
+                    ClassOf(result[result.size() - 1]);
+                if(previous != Bracket && previous == ClassOf(c))
+                    result += ' ';
+            }
+            pendingSpace = false;
+            result += char(c);
+        }
+        return result;
+    }
+
+    FunctionParserCache(const FunctionParserCache&); // not implemented on purpose
+    FunctionParserCache& operator=(const FunctionParserCache&); // ditto
+};
+
+#endif
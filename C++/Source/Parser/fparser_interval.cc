@@ -0,0 +1,577 @@
+/***************************************************************************\
+|* Function Parser for C++ v4.5.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Interval evaluation for FunctionParserBase<double>                      *|
+\***************************************************************************/
+
+#include "fpconfig.hh"
+#include "fparser_interval.hh"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "extrasrc/fptypes.hh"
+#include "extrasrc/fpaux.hh"
+using namespace FUNCTIONPARSERTYPES;
+
+typedef FunctionParserInterval::Interval Interval;
+
+namespace
+{
+//=========================================================================
+// Rounding and special intervals
+//=========================================================================
+    const double Inf = std::numeric_limits<double>::infinity();
+    const double Pi = 3.141592653589793;
+
+    const Interval Empty = { Inf, -Inf };
+    const Interval Whole = { -Inf, Inf };
+
+    // Ulps added to the results of the math library, which are not
+    // correctly rounded but are within one ulp on the usual platforms
+    const int LibraryUlps = 2;
+
+    double Down(double x, int ulps = 1)
+    {
+        for(int i = 0; i < ulps; ++i) x = std::nextafter(x, -Inf);
+        return x;
+    }
+
+    double Up(double x, int ulps = 1)
+    {
+        for(int i = 0; i < ulps; ++i) x = std::nextafter(x, Inf);
+        return x;
+    }
+
+    Interval Make(double lower, double upper, int ulps)
+    {
+        if(lower != lower || upper != upper) return Whole;
+        const Interval result = { Down(lower, ulps), Up(upper, ulps) };
+        return result;
+    }
+
+    Interval Point(double x)
+    {
+        const Interval result = { x, x };
+        return result;
+    }
+
+    Interval Hull(const Interval& x, const Interval& y)
+    {
+        if(FunctionParserInterval::IsEmpty(x)) return y;
+        if(FunctionParserInterval::IsEmpty(y)) return x;
+        const Interval result =
+            { std::min(x.lower, y.lower), std::max(x.upper, y.upper) };
+        return result;
+    }
+
+    // Keeps the bounds of a function inside its range
+    Interval Clamp(Interval x, double lower, double upper)
+    {
+        if(x.lower < lower) x.lower = lower;
+        if(x.upper > upper) x.upper = upper;
+        return x;
+    }
+
+    // 0 * inf is 0 in interval arithmetic: the infinite bound is not reached
+    double Product(double x, double y)
+    {
+        return x == 0.0 || y == 0.0 ? 0.0 : x * y;
+    }
+
+//=========================================================================
+// Elementary functions
+//=========================================================================
+    typedef double (*Function)(double);
+
+    Interval Increasing(const Interval& x, Function f)
+    {
+        if(FunctionParserInterval::IsEmpty(x)) return Empty;
+        return Make(f(x.lower), f(x.upper), LibraryUlps);
+    }
+
+    Interval Decreasing(const Interval& x, Function f)
+    {
+        if(FunctionParserInterval::IsEmpty(x)) return Empty;
+        return Make(f(x.upper), f(x.lower), LibraryUlps);
+    }
+
+    // Leaves out the part of x outside of the domain [lower, upper]
+    Interval Domain(const Interval& x, double lower, double upper)
+    {
+        const Interval domain = { lower, upper };
+        return FunctionParserInterval::Intersect(x, domain);
+    }
+
+    Interval Neg(const Interval& x)
+    {
+        const Interval result = { -x.upper, -x.lower };
+        return result;
+    }
+
+    Interval Abs(const Interval& x)
+    {
+        if(FunctionParserInterval::IsEmpty(x)) return Empty;
+        if(x.lower >= 0.0) return x;
+        if(x.upper <= 0.0) return Neg(x);
+        const Interval result = { 0.0, std::max(-x.lower, x.upper) };
+        return result;
+    }
+
+    Interval Inv(const Interval& x)
+    {
+        if(FunctionParserInterval::IsEmpty(x)) return Empty;
+        if(x.lower > 0.0 || x.upper < 0.0)
+            return Make(1.0 / x.upper, 1.0 / x.lower, 1);
+        if(x.lower == 0.0 && x.upper == 0.0) return Empty;
+        if(x.lower == 0.0)
+        {
+            const Interval result = { Down(1.0 / x.upper), Inf };
+            return result;
+        }
+        if(x.upper == 0.0)
+        {
+            const Interval result = { -Inf, Up(1.0 / x.lower) };
+            return result;
+        }
+        return Whole;
+    }
+
+    Interval Sqr(const Interval& x)
+    {
+        const Interval a = Abs(x);
+        if(FunctionParserInterval::IsEmpty(a)) return Empty;
+        return Clamp(Make(a.lower * a.lower, a.upper * a.upper, 1), 0.0, Inf);
+    }
+
+    Interval Sqrt(const Interval& x)
+    {
+        return Clamp(Increasing(Domain(x, 0.0, Inf), std::sqrt), 0.0, Inf);
+    }
+
+    double Exp2(double x) { return fp_exp2(x); }
+    double Int(double x) { return fp_int(x); }
+    double Trunc(double x) { return fp_trunc(x); }
+
+    // log(0) is -inf, which is the bound of the values near 0
+    Interval Log(const Interval& x, Function f)
+    {
+        const Interval positive = Domain(x, 0.0, Inf);
+        if(FunctionParserInterval::IsEmpty(positive) || positive.upper == 0.0)
+            return Empty;
+        return Increasing(positive, f);
+    }
+
+    // Rounding functions are exact and monotonic
+    Interval Step(const Interval& x, Function f)
+    {
+        if(FunctionParserInterval::IsEmpty(x)) return Empty;
+        const Interval result = { f(x.lower), f(x.upper) };
+        return result;
+    }
+
+    // Whether x, slightly widened, contains offset + k*period
+    bool ContainsPeriodic(const Interval& x, double offset, double period)
+    {
+        const double margin =
+            16.0 * std::numeric_limits<double>::epsilon() *
+            (1.0 + std::max(std::fabs(x.lower), std::fabs(x.upper)));
+        const double k = std::ceil((x.lower - margin - offset) / period);
+        return offset + k * period <= x.upper + margin;
+    }
+
+    // sin and cos have their maxima at maximum + 2k*pi and their minima
+    // at maximum + pi + 2k*pi; they are monotonic in between
+    Interval SinCos(const Interval& x, Function f, double maximum)
+    {
+        if(FunctionParserInterval::IsEmpty(x)) return Empty;
+        const Interval unit = { -1.0, 1.0 };
+        if(!(x.upper - x.lower < 2.0 * Pi)) return unit;
+        const double a = f(x.lower), b = f(x.upper);
+        Interval result = Make(std::min(a, b), std::max(a, b), LibraryUlps);
+        if(ContainsPeriodic(x, maximum, 2.0 * Pi)) result.upper = 1.0;
+        if(ContainsPeriodic(x, maximum + Pi, 2.0 * Pi)) result.lower = -1.0;
+        return Clamp(result, -1.0, 1.0);
+    }
+
+    double Sin(double x) { return std::sin(x); }
+    double Cos(double x) { return std::cos(x); }
+
+    Interval Tan(const Interval& x)
+    {
+        if(FunctionParserInterval::IsEmpty(x)) return Empty;
+        if(!(x.upper - x.lower < Pi) || ContainsPeriodic(x, Pi / 2.0, Pi))
+            return Whole;
+        return Increasing(x, std::tan);
+    }
+
+    Interval Cosh(const Interval& x)
+    {
+        return Clamp(Increasing(Abs(x), std::cosh), 1.0, Inf);
+    }
+
+    // Widens the bounds by a relative error
+    Interval Relative(const Interval& x, double error)
+    {
+        if(FunctionParserInterval::IsEmpty(x)) return Empty;
+        const Interval result =
+            { x.lower - Product(std::fabs(x.lower), error),
+              x.upper + Product(std::fabs(x.upper), error) };
+        return result;
+    }
+
+    // fp_powi() multiplies up to 2*log2(n) times, each adding an ulp
+    Interval PowInt(const Interval& x, double n)
+    {
+        if(n == 0.0) return Point(1.0);
+        if(n < 0.0) return Inv(PowInt(x, -n));
+        if(FunctionParserInterval::IsEmpty(x)) return Empty;
+        const double error =
+            2.0 * std::numeric_limits<double>::epsilon() * (2.0 + std::log2(n));
+        if(std::fmod(n, 2.0) != 0.0)
+            return Relative(Make(std::pow(x.lower, n), std::pow(x.upper, n),
+                                 LibraryUlps), error);
+        const Interval a = Abs(x);
+        return Clamp(Relative(Make(std::pow(a.lower, n), std::pow(a.upper, n),
+                                   LibraryUlps), error), 0.0, Inf);
+    }
+
+    // x^y on a box of positive bases: it is monotonic in each argument,
+    // so the extrema are at the corners. fp_pow() computes exp(y*log(x)),
+    // whose relative error grows with |y*log(x)|: the bounds include it.
+    Interval PowCorners(const Interval& x, const Interval& y)
+    {
+        const double values[4] =
+            { std::pow(x.lower, y.lower), std::pow(x.lower, y.upper),
+              std::pow(x.upper, y.lower), std::pow(x.upper, y.upper) };
+        const double smallest = std::numeric_limits<double>::min();
+        const double logs[2] =
+            { std::fabs(std::log(std::max(x.lower, smallest))),
+              std::fabs(std::log(std::max(x.upper, smallest))) };
+        const double error = 4.0 * std::numeric_limits<double>::epsilon() *
+            (1.0 + std::max(logs[0], logs[1]) *
+             std::max(std::fabs(y.lower), std::fabs(y.upper)));
+        return Clamp(Relative(Make(*std::min_element(values, values + 4),
+                                   *std::max_element(values, values + 4),
+                                   LibraryUlps), error), 0.0, Inf);
+    }
+
+    // Follows fp_pow(): a negative base with a non-integer exponent gives
+    // -(|x|^y), unless 16*y is an integer, where it is not defined
+    Interval Pow(const Interval& x, const Interval& y)
+    {
+        if(FunctionParserInterval::IsEmpty(x) ||
+           FunctionParserInterval::IsEmpty(y)) return Empty;
+        const bool pointExponent = y.lower == y.upper;
+        if(pointExponent && std::fabs(y.lower) < 9007199254740992.0 &&
+           y.lower == std::floor(y.lower))
+            return PowInt(x, y.lower);
+
+        Interval result = Empty;
+        const Interval positive = Domain(x, 0.0, Inf);
+        if(!FunctionParserInterval::IsEmpty(positive))
+            result = PowCorners(positive, y);
+        if(x.lower < 0.0)
+        {
+            if(!pointExponent) return Whole;
+            const double y16 = y.lower * 16.0;
+            if(y16 != std::floor(y16))
+            {
+                const Interval magnitude =
+                    { x.upper < 0.0 ? -x.upper : 0.0, -x.lower };
+                result = Hull(result, Neg(PowCorners(magnitude, y)));
+            }
+        }
+        return result;
+    }
+
+    bool ContainsZero(const Interval& x)
+    {
+        return x.lower <= 0.0 && x.upper >= 0.0;
+    }
+
+    // Whether the operation on the top of the stack is defined and
+    // continuous on the whole intervals of its arguments
+    bool IsContinuous(unsigned opcode, const Interval* Stack, int SP)
+    {
+        const Interval& x = Stack[SP];
+        if(FunctionParserInterval::IsEmpty(x)) return false;
+        switch(opcode)
+        {
+          case cAcos: case cAsin: return x.lower >= -1.0 && x.upper <= 1.0;
+          case cAtanh: return x.lower > -1.0 && x.upper < 1.0;
+          case cAcosh: return x.lower >= 1.0;
+          case cSqrt: return x.lower >= 0.0;
+          case cRSqrt: case cLog: case cLog2: case cLog10: return x.lower > 0.0;
+          case cInv: case cDiv: return !ContainsZero(x);
+          case cRDiv: return !ContainsZero(Stack[SP-1]);
+          case cTan: case cSec:
+              return x.upper - x.lower < Pi && !ContainsPeriodic(x, Pi / 2.0, Pi);
+          case cCot: case cCsc:
+              return x.upper - x.lower < Pi && !ContainsPeriodic(x, 0.0, Pi);
+          case cCeil: return std::ceil(x.lower) == std::ceil(x.upper);
+          case cFloor: return std::floor(x.lower) == std::floor(x.upper);
+          case cInt: return fp_int(x.lower) == fp_int(x.upper);
+          case cTrunc: return fp_trunc(x.lower) == fp_trunc(x.upper);
+          case cAtan2:
+              // Not continuous across the negative x axis
+              return !FunctionParserInterval::IsEmpty(Stack[SP-1]) &&
+                  (x.lower > 0.0 || !ContainsZero(Stack[SP-1]));
+          case cPow:
+              {
+                  const Interval& base = Stack[SP-1];
+                  if(FunctionParserInterval::IsEmpty(base)) return false;
+                  if(x.lower == x.upper && x.lower == std::floor(x.lower))
+                      return x.lower >= 0.0 || !ContainsZero(base);
+                  return base.lower > 0.0 || (base.lower == 0.0 && x.lower > 0.0);
+              }
+#ifdef FP_SUPPORT_OPTIMIZER
+          case cLog2by:
+              return Stack[SP-1].lower > 0.0;
+#endif
+          default: return true;
+        }
+    }
+}
+
+//=========================================================================
+// Arithmetic
+//=========================================================================
+Interval FunctionParserInterval::Add(const Interval& x, const Interval& y)
+{
+    if(IsEmpty(x) || IsEmpty(y)) return Empty;
+    return Make(x.lower + y.lower, x.upper + y.upper, 1);
+}
+
+Interval FunctionParserInterval::Sub(const Interval& x, const Interval& y)
+{
+    if(IsEmpty(x) || IsEmpty(y)) return Empty;
+    return Make(x.lower - y.upper, x.upper - y.lower, 1);
+}
+
+Interval FunctionParserInterval::Mul(const Interval& x, const Interval& y)
+{
+    if(IsEmpty(x) || IsEmpty(y)) return Empty;
+    const double values[4] =
+        { Product(x.lower, y.lower), Product(x.lower, y.upper),
+          Product(x.upper, y.lower), Product(x.upper, y.upper) };
+    return Make(*std::min_element(values, values + 4),
+                *std::max_element(values, values + 4), 1);
+}
+
+Interval FunctionParserInterval::Div(const Interval& x, const Interval& y)
+{
+    if(IsEmpty(x) || IsEmpty(y)) return Empty;
+    if(y.lower <= 0.0 && y.upper >= 0.0) return Mul(x, Inv(y));
+    const double values[4] =
+        { x.lower / y.lower, x.lower / y.upper,
+          x.upper / y.lower, x.upper / y.upper };
+    return Make(*std::min_element(values, values + 4),
+                *std::max_element(values, values + 4), 1);
+}
+
+Interval FunctionParserInterval::Intersect(const Interval& x, const Interval& y)
+{
+    if(IsEmpty(x) || IsEmpty(y)) return Empty;
+    const Interval result =
+        { std::max(x.lower, y.lower), std::min(x.upper, y.upper) };
+    return IsEmpty(result) ? Empty : result;
+}
+
+
+//=========================================================================
+// Evaluation
+//=========================================================================
+FunctionParserInterval::FunctionParserInterval
+(const FunctionParserBase<double>& parser):
+    mParser(parser),
+    mSupported(mParser.mData->mParseErrorType ==
+               FunctionParserBase<double>::FP_NO_ERROR &&
+               !mParser.mData->mByteCode.empty())
+{
+    const std::vector<unsigned>& byteCode = mParser.mData->mByteCode;
+    for(std::size_t IP = 0; mSupported && IP < byteCode.size(); ++IP)
+    {
+        const unsigned opcode = byteCode[IP];
+        switch(opcode)
+        {
+          case cFetch: ++IP; break;
+#ifdef FP_SUPPORT_OPTIMIZER
+          case cPopNMov: IP += 2; break;
+#endif
+          case cIf: case cAbsIf: case cJump:
+          case cMod: case cEqual: case cNEqual: case cLess: case cLessOrEq:
+          case cGreater: case cGreaterOrEq: case cNot: case cAnd: case cOr:
+          case cNotNot: case cAbsAnd: case cAbsOr: case cAbsNot:
+          case cAbsNotNot: case cFCall: case cPCall:
+          case cArg: case cConj: case cImag: case cReal: case cPolar:
+              mSupported = false;
+              break;
+          default: break;
+        }
+    }
+    mStack.resize(GetStackSize());
+}
+
+unsigned FunctionParserInterval::GetStackSize() const
+{
+    return std::max(mParser.mData->mStackSize, 1u);
+}
+
+Interval FunctionParserInterval::Eval(const Interval* Vars)
+{
+    return Eval(Vars, &mStack[0]);
+}
+
+Interval FunctionParserInterval::Eval(const Interval* Vars,
+                                      Interval* Stack, bool* Continuous) const
+{
+    if(Continuous) *Continuous = mSupported;
+    if(!mSupported) return Whole;
+
+    const std::vector<unsigned>& byteCode = mParser.mData->mByteCode;
+    const std::vector<double>& immed = mParser.mData->mImmed;
+    const unsigned byteCodeSize = unsigned(byteCode.size());
+    unsigned IP, DP = 0;
+    int SP = -1;
+
+    for(IP = 0; IP < byteCodeSize; ++IP)
+    {
+        if(Continuous && SP >= 0 && *Continuous &&
+           !IsContinuous(byteCode[IP], Stack, SP))
+            *Continuous = false;
+
+        switch(byteCode[IP])
+        {
+          case cAbs: Stack[SP] = Abs(Stack[SP]); break;
+          case cAcos:
+              Stack[SP] = Decreasing(Domain(Stack[SP], -1.0, 1.0), std::acos);
+              break;
+          case cAcosh:
+              Stack[SP] = Increasing(Domain(Stack[SP], 1.0, Inf), std::acosh);
+              break;
+          case cAsin:
+              Stack[SP] = Increasing(Domain(Stack[SP], -1.0, 1.0), std::asin);
+              break;
+          case cAsinh: Stack[SP] = Increasing(Stack[SP], std::asinh); break;
+          case cAtan: Stack[SP] = Increasing(Stack[SP], std::atan); break;
+          case cAtan2:
+              // Only the range of atan2 is used
+              if(IsEmpty(Stack[SP-1]) || IsEmpty(Stack[SP]))
+                  Stack[SP-1] = Empty;
+              else
+                  Stack[SP-1] = Make(-Pi, Pi, 1);
+              --SP; break;
+          case cAtanh:
+              Stack[SP] = Increasing(Domain(Stack[SP], -1.0, 1.0), std::atanh);
+              break;
+          case cCbrt: Stack[SP] = Increasing(Stack[SP], std::cbrt); break;
+          case cCeil: Stack[SP] = Step(Stack[SP], std::ceil); break;
+          case cCos: Stack[SP] = SinCos(Stack[SP], Cos, 0.0); break;
+          case cCosh: Stack[SP] = Cosh(Stack[SP]); break;
+          case cCot: Stack[SP] = Inv(Tan(Stack[SP])); break;
+          case cCsc: Stack[SP] = Inv(SinCos(Stack[SP], Sin, Pi / 2.0)); break;
+          case cExp:
+              Stack[SP] = Clamp(Increasing(Stack[SP], std::exp), 0.0, Inf);
+              break;
+          case cExp2:
+              Stack[SP] = Clamp(Increasing(Stack[SP], Exp2), 0.0, Inf);
+              break;
+          case cFloor: Stack[SP] = Step(Stack[SP], std::floor); break;
+          case cHypot:
+              Stack[SP-1] = Sqrt(Add(Sqr(Stack[SP-1]), Sqr(Stack[SP])));
+              --SP; break;
+          case cInt: Stack[SP] = Step(Stack[SP], Int); break;
+          case cLog: Stack[SP] = Log(Stack[SP], std::log); break;
+          case cLog10: Stack[SP] = Log(Stack[SP], std::log10); break;
+          case cLog2: Stack[SP] = Log(Stack[SP], std::log2); break;
+          case cMax:
+              if(IsEmpty(Stack[SP-1]) || IsEmpty(Stack[SP]))
+                  Stack[SP-1] = Empty;
+              else
+              {
+                  Stack[SP-1].lower = std::max(Stack[SP-1].lower, Stack[SP].lower);
+                  Stack[SP-1].upper = std::max(Stack[SP-1].upper, Stack[SP].upper);
+              }
+              --SP; break;
+          case cMin:
+              if(IsEmpty(Stack[SP-1]) || IsEmpty(Stack[SP]))
+                  Stack[SP-1] = Empty;
+              else
+              {
+                  Stack[SP-1].lower = std::min(Stack[SP-1].lower, Stack[SP].lower);
+                  Stack[SP-1].upper = std::min(Stack[SP-1].upper, Stack[SP].upper);
+              }
+              --SP; break;
+          case cPow: Stack[SP-1] = Pow(Stack[SP-1], Stack[SP]); --SP; break;
+          case cSec: Stack[SP] = Inv(SinCos(Stack[SP], Cos, 0.0)); break;
+          case cSin: Stack[SP] = SinCos(Stack[SP], Sin, Pi / 2.0); break;
+          case cSinh: Stack[SP] = Increasing(Stack[SP], std::sinh); break;
+          case cSqrt: Stack[SP] = Sqrt(Stack[SP]); break;
+          case cTan: Stack[SP] = Tan(Stack[SP]); break;
+          case cTanh:
+              Stack[SP] = Clamp(Increasing(Stack[SP], std::tanh), -1.0, 1.0);
+              break;
+          case cTrunc: Stack[SP] = Step(Stack[SP], Trunc); break;
+
+          case cImmed: Stack[++SP] = Point(immed[DP++]); break;
+
+          case cNeg: Stack[SP] = Neg(Stack[SP]); break;
+          case cAdd: Stack[SP-1] = Add(Stack[SP-1], Stack[SP]); --SP; break;
+          case cSub: Stack[SP-1] = Sub(Stack[SP-1], Stack[SP]); --SP; break;
+          case cMul: Stack[SP-1] = Mul(Stack[SP-1], Stack[SP]); --SP; break;
+          case cDiv: Stack[SP-1] = Div(Stack[SP-1], Stack[SP]); --SP; break;
+
+          case cDeg:
+              Stack[SP] = Mul(Stack[SP], Make(fp_const_rad_to_deg<double>(),
+                                              fp_const_rad_to_deg<double>(), 1));
+              break;
+          case cRad:
+              Stack[SP] = Mul(Stack[SP], Make(fp_const_deg_to_rad<double>(),
+                                              fp_const_deg_to_rad<double>(), 1));
+              break;
+
+#ifdef FP_SUPPORT_OPTIMIZER
+          case cPopNMov:
+              {
+                  const unsigned target = byteCode[++IP];
+                  const unsigned source = byteCode[++IP];
+                  Stack[target] = Stack[source];
+                  SP = int(target);
+                  break;
+              }
+
+          case cLog2by:
+              Stack[SP-1] = Mul(Log(Stack[SP-1], std::log2), Stack[SP]);
+              --SP; break;
+
+          case cNop: break;
+#endif
+
+          case cSinCos:
+              Stack[SP+1] = SinCos(Stack[SP], Cos, 0.0);
+              Stack[SP] = SinCos(Stack[SP], Sin, Pi / 2.0);
+              ++SP; break;
+          case cSinhCosh:
+              Stack[SP+1] = Cosh(Stack[SP]);
+              Stack[SP] = Increasing(Stack[SP], std::sinh);
+              ++SP; break;
+
+          case cDup: Stack[SP+1] = Stack[SP]; ++SP; break;
+          case cFetch: Stack[SP+1] = Stack[byteCode[++IP]]; ++SP; break;
+
+          case cInv: Stack[SP] = Inv(Stack[SP]); break;
+          case cSqr: Stack[SP] = Sqr(Stack[SP]); break;
+          case cRDiv: Stack[SP-1] = Div(Stack[SP], Stack[SP-1]); --SP; break;
+          case cRSub: Stack[SP-1] = Sub(Stack[SP], Stack[SP-1]); --SP; break;
+          case cRSqrt: Stack[SP] = Inv(Sqrt(Stack[SP])); break;
+
+          default:
+              Stack[++SP] = Vars[byteCode[IP] - VarBegin];
+        }
+    }
+
+    if(Continuous && IsEmpty(Stack[SP])) *Continuous = false;
+    return Stack[SP];
+}
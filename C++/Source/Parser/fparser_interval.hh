@@ -0,0 +1,70 @@
+/***************************************************************************\
+|* Function Parser for C++ v4.5.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Interval evaluation for FunctionParserBase<double>                      *|
+\***************************************************************************/
+
+#ifndef ONCE_FPARSER_INTERVAL_H_
+#define ONCE_FPARSER_INTERVAL_H_
+
+#include "fparser.hh"
+#include <vector>
+
+/* Evaluates the bytecode of a parsed function with interval arithmetic:
+   when every variable takes any value of its interval, the value of the
+   function is inside the resulting interval. Every bound is rounded
+   outwards (by one ulp after the arithmetic operations, by two after the
+   functions of the math library), so the enclosure holds in spite of the
+   rounding errors.
+
+   The points where the function is not defined are left out: sqrt() of
+   [-1, 4] is [0, 2], and the result is empty (lower > upper) when the
+   function is not defined anywhere in the intervals. A division by an
+   interval containing zero gives [-inf, inf].
+
+   Comparisons, logical operators, if(), mod and user-defined functions
+   have no interval version: IsSupported() is then false and Eval() always
+   gives [-inf, inf]. Eval() with a stack of the caller doesn't change the
+   object, so it can be called by several threads simultaneously.
+*/
+class FunctionParserInterval
+{
+ public:
+    struct Interval
+    {
+        double lower, upper;
+    };
+
+    explicit FunctionParserInterval(const FunctionParserBase<double>& parser);
+
+    bool IsSupported() const { return mSupported; }
+
+    // Vars holds an interval for every variable of the parser
+    Interval Eval(const Interval* Vars);
+    // Stack must have room for GetStackSize() intervals. Continuous, when
+    // given, is set to false if the function may be undefined or not
+    // continuous somewhere in the intervals (sqrt() of negative values, a
+    // division by an interval containing zero, floor() of a non-integer
+    // interval...), where the mean value theorem doesn't hold.
+    Interval Eval(const Interval* Vars, Interval* Stack,
+                  bool* Continuous = 0) const;
+    unsigned GetStackSize() const;
+
+    // Operations with outward rounding, also available to the callers
+    static bool IsEmpty(const Interval& x) { return !(x.lower <= x.upper); }
+    static Interval Add(const Interval& x, const Interval& y);
+    static Interval Sub(const Interval& x, const Interval& y);
+    static Interval Mul(const Interval& x, const Interval& y);
+    static Interval Div(const Interval& x, const Interval& y);
+    static Interval Intersect(const Interval& x, const Interval& y);
+
+
+//========================================================================
+ private:
+//========================================================================
+    FunctionParserBase<double> mParser;
+    std::vector<Interval> mStack;
+    bool mSupported;
+};
+
+#endif
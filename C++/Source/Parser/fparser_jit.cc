@@ -0,0 +1,575 @@
+/***************************************************************************\
+|* Function Parser for C++ v4.5.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Native code compiler for FunctionParserBase<double>                     *|
+\***************************************************************************/
+
+#include "fpconfig.hh"
+#include "fparser_jit.hh"
+
+#include <vector>
+#include <cstring>
+
+#include "extrasrc/fptypes.hh"
+#include "extrasrc/fpaux.hh"
+using namespace FUNCTIONPARSERTYPES;
+
+#if !defined(FP_DISABLE_DOUBLE_TYPE) && (defined(__x86_64__) || defined(_M_X64))
+#define FP_JIT_X86_64
+#ifdef _WIN32
+#define FP_JIT_WIN64
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+#ifdef FP_JIT_X86_64
+namespace
+{
+//=========================================================================
+// Functions called by the compiled code
+//=========================================================================
+    typedef double (*UnaryFunction)(double);
+    typedef double (*BinaryFunction)(double, double);
+
+    double jitAcos(double x) { return fp_acos(x); }
+    double jitAcosh(double x) { return fp_acosh(x); }
+    double jitAsin(double x) { return fp_asin(x); }
+    double jitAsinh(double x) { return fp_asinh(x); }
+    double jitAtan(double x) { return fp_atan(x); }
+    double jitAtanh(double x) { return fp_atanh(x); }
+    double jitCbrt(double x) { return fp_cbrt(x); }
+    double jitCeil(double x) { return fp_ceil(x); }
+    double jitCos(double x) { return fp_cos(x); }
+    double jitCosh(double x) { return fp_cosh(x); }
+    double jitCot(double x) { return 1.0 / fp_tan(x); }
+    double jitCsc(double x) { return 1.0 / fp_sin(x); }
+    double jitExp(double x) { return fp_exp(x); }
+    double jitExp2(double x) { return fp_exp2(x); }
+    double jitFloor(double x) { return fp_floor(x); }
+    double jitInt(double x) { return fp_int(x); }
+    double jitLog(double x) { return fp_log(x); }
+    double jitLog10(double x) { return fp_log10(x); }
+    double jitLog2(double x) { return fp_log2(x); }
+    double jitSec(double x) { return 1.0 / fp_cos(x); }
+    double jitSin(double x) { return fp_sin(x); }
+    double jitSinh(double x) { return fp_sinh(x); }
+    double jitTan(double x) { return fp_tan(x); }
+    double jitTanh(double x) { return fp_tanh(x); }
+    double jitTrunc(double x) { return fp_trunc(x); }
+    double jitNot(double x) { return fp_not(x); }
+    double jitNotNot(double x) { return fp_notNot(x); }
+    double jitAbsNot(double x) { return fp_absNot(x); }
+    double jitAbsNotNot(double x) { return fp_absNotNot(x); }
+
+    double jitAtan2(double x, double y) { return fp_atan2(x, y); }
+    double jitHypot(double x, double y) { return fp_hypot(x, y); }
+    double jitMax(double x, double y) { return fp_max(x, y); }
+    double jitMin(double x, double y) { return fp_min(x, y); }
+    double jitPow(double x, double y) { return fp_pow(x, y); }
+    double jitMod(double x, double y) { return fp_mod(x, y); }
+    double jitEqual(double x, double y) { return fp_equal(x, y); }
+    double jitNEqual(double x, double y) { return fp_nequal(x, y); }
+    double jitLess(double x, double y) { return fp_less(x, y); }
+    double jitLessOrEq(double x, double y) { return fp_lessOrEq(x, y); }
+    double jitGreater(double x, double y) { return fp_less(y, x); }
+    double jitGreaterOrEq(double x, double y) { return fp_lessOrEq(y, x); }
+    double jitAnd(double x, double y) { return fp_and(x, y); }
+    double jitOr(double x, double y) { return fp_or(x, y); }
+    double jitAbsAnd(double x, double y) { return fp_absAnd(x, y); }
+    double jitAbsOr(double x, double y) { return fp_absOr(x, y); }
+    double jitLog2by(double x, double y) { return fp_log2(x) * y; }
+
+    UnaryFunction unaryFunction(unsigned opcode)
+    {
+        switch(opcode)
+        {
+          case cAcos: return jitAcos;
+          case cAcosh: return jitAcosh;
+          case cAsin: return jitAsin;
+          case cAsinh: return jitAsinh;
+          case cAtan: return jitAtan;
+          case cAtanh: return jitAtanh;
+          case cCbrt: return jitCbrt;
+          case cCeil: return jitCeil;
+          case cCos: return jitCos;
+          case cCosh: return jitCosh;
+          case cCot: return jitCot;
+          case cCsc: return jitCsc;
+          case cExp: return jitExp;
+          case cExp2: return jitExp2;
+          case cFloor: return jitFloor;
+          case cInt: return jitInt;
+          case cLog: return jitLog;
+          case cLog10: return jitLog10;
+          case cLog2: return jitLog2;
+          case cSec: return jitSec;
+          case cSin: return jitSin;
+          case cSinh: return jitSinh;
+          case cTan: return jitTan;
+          case cTanh: return jitTanh;
+          case cTrunc: return jitTrunc;
+          case cNot: return jitNot;
+          case cNotNot: return jitNotNot;
+          case cAbsNot: return jitAbsNot;
+          case cAbsNotNot: return jitAbsNotNot;
+          default: return 0;
+        }
+    }
+
+    BinaryFunction binaryFunction(unsigned opcode)
+    {
+        switch(opcode)
+        {
+          case cAtan2: return jitAtan2;
+          case cHypot: return jitHypot;
+          case cMax: return jitMax;
+          case cMin: return jitMin;
+          case cPow: return jitPow;
+          case cMod: return jitMod;
+          case cEqual: return jitEqual;
+          case cNEqual: return jitNEqual;
+          case cLess: return jitLess;
+          case cLessOrEq: return jitLessOrEq;
+          case cGreater: return jitGreater;
+          case cGreaterOrEq: return jitGreaterOrEq;
+          case cAnd: return jitAnd;
+          case cOr: return jitOr;
+          case cAbsAnd: return jitAbsAnd;
+          case cAbsOr: return jitAbsOr;
+#ifdef FP_SUPPORT_OPTIMIZER
+          case cLog2by: return jitLog2by;
+#endif
+          default: return 0;
+        }
+    }
+
+//=========================================================================
+// x86-64 code generation
+//=========================================================================
+    /* Stack position i of the bytecode lives in register xmm(i+2). xmm0 and
+       xmm1 pass the arguments of function calls, xmm14 and xmm15 are used
+       as temporaries. The registers are saved to a spill area of the native
+       stack frame around function calls.
+
+       Frame layout (offsets from rsp, after the prologue):
+         0..31     shadow space for calls (required by the Win64 ABI)
+         32..127   spill area for the 12 stack positions
+         128..287  saved xmm6..xmm15 (callee-saved in the Win64 ABI)
+     */
+    const unsigned MaxStackSize = 12;
+    const unsigned SpillOffset = 32;
+    const unsigned SaveOffset = SpillOffset + 8 * MaxStackSize;
+    const unsigned FrameSize = SaveOffset + 16 * 10;
+
+    const unsigned RSP = 4, RBX = 3;
+    const unsigned Temp1 = 14, Temp2 = 15;
+
+    enum SseOpcode
+    {
+        MOVSD_LOAD = 0x10, MOVSD_STORE = 0x11, MOVAPD = 0x28,
+        SQRTSD = 0x51, ANDPD = 0x54, XORPD = 0x57,
+        ADDSD = 0x58, MULSD = 0x59, SUBSD = 0x5C, DIVSD = 0x5E,
+        UCOMISD = 0x2E
+    };
+
+    inline unsigned slot(int stackPosition) { return unsigned(stackPosition) + 2; }
+
+    class Assembler
+    {
+     public:
+        std::vector<unsigned char> mCode;
+
+        void byte(unsigned value) { mCode.push_back((unsigned char)value); }
+
+        void dword(unsigned value)
+        {
+            for(unsigned i = 0; i < 4; ++i) byte((value >> (8 * i)) & 0xFF);
+        }
+
+        void qword(unsigned long long value)
+        {
+            for(unsigned i = 0; i < 8; ++i) byte(unsigned(value >> (8 * i)) & 0xFF);
+        }
+
+        // [prefix] 0F op, with xmm registers reg and rm
+        void sse(unsigned prefix, unsigned op, unsigned reg, unsigned rm)
+        {
+            if(prefix) byte(prefix);
+            if(reg >= 8 || rm >= 8)
+                byte(0x40 | (reg >= 8 ? 4 : 0) | (rm >= 8 ? 1 : 0));
+            byte(0x0F); byte(op); byte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+        }
+
+        // [prefix] 0F op, with xmm register reg and memory [base + disp32]
+        void sseMem(unsigned prefix, unsigned op, unsigned reg,
+                    unsigned base, unsigned disp)
+        {
+            if(prefix) byte(prefix);
+            if(reg >= 8) byte(0x44);
+            byte(0x0F); byte(op); byte(0x80 | ((reg & 7) << 3) | base);
+            if(base == RSP) byte(0x24);
+            dword(disp);
+        }
+
+        void move(unsigned dest, unsigned source)
+        {
+            if(dest != source) sse(0x66, MOVAPD, dest, source);
+        }
+
+        void loadBits(unsigned xmm, unsigned long long bits)
+        {
+            byte(0x48); byte(0xB8); qword(bits);              // mov rax, imm64
+            byte(0x66); byte(xmm >= 8 ? 0x4C : 0x48);          // movq xmm, rax
+            byte(0x0F); byte(0x6E); byte(0xC0 | ((xmm & 7) << 3));
+        }
+
+        void loadConstant(unsigned xmm, double value)
+        {
+            unsigned long long bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            loadBits(xmm, bits);
+        }
+
+        void spill(unsigned xmm, unsigned index)
+        { sseMem(0xF2, MOVSD_STORE, xmm, RSP, SpillOffset + 8 * index); }
+
+        void unspill(unsigned xmm, unsigned index)
+        { sseMem(0xF2, MOVSD_LOAD, xmm, RSP, SpillOffset + 8 * index); }
+
+        void call(const void* function)
+        {
+            byte(0x48); byte(0xB8);                             // mov rax, imm64
+            qword((unsigned long long)(std::size_t)(function));
+            byte(0xFF); byte(0xD0);                             // call rax
+        }
+
+        // Emits a jump with a 32-bit displacement to be filled in later
+        // and returns the position of the displacement.
+        std::size_t jump(bool ifBelow)
+        {
+            if(ifBelow) { byte(0x0F); byte(0x82); }             // jb rel32
+            else byte(0xE9);                                    // jmp rel32
+            dword(0);
+            return mCode.size() - 4;
+        }
+
+        void prologue()
+        {
+            byte(0x53);                                         // push rbx
+            byte(0x48); byte(0x81); byte(0xEC); dword(FrameSize); // sub rsp
+#ifdef FP_JIT_WIN64
+            for(unsigned i = 0; i < 10; ++i)                    // movups
+                sseMem(0, 0x11, 6 + i, RSP, SaveOffset + 16 * i);
+            byte(0x48); byte(0x89); byte(0xCB);                 // mov rbx, rcx
+#else
+            byte(0x48); byte(0x89); byte(0xFB);                 // mov rbx, rdi
+#endif
+        }
+
+        void epilogue()
+        {
+#ifdef FP_JIT_WIN64
+            for(unsigned i = 0; i < 10; ++i)                    // movups
+                sseMem(0, 0x10, 6 + i, RSP, SaveOffset + 16 * i);
+#endif
+            byte(0x48); byte(0x81); byte(0xC4); dword(FrameSize); // add rsp
+            byte(0x5B);                                         // pop rbx
+            byte(0xC3);                                         // ret
+        }
+
+        /* Calls function with the topmost params stack positions as the
+           arguments, replacing them with the return value. */
+        void callFunction(const void* function, unsigned params, int& SP)
+        {
+            const int first = SP - int(params) + 1;
+            for(int i = 0; i < first; ++i) spill(slot(i), i);
+            for(unsigned i = 0; i < params; ++i) move(i, slot(first + i));
+            call(function);
+            for(int i = 0; i < first; ++i) unspill(slot(i), i);
+            move(slot(first), 0);
+            SP = first;
+        }
+
+        // Pushes f1(x) and f2(x) in place of x (used for cSinCos)
+        void callFunctionPair(const void* function1, const void* function2,
+                              int& SP)
+        {
+            for(int i = 0; i <= SP; ++i) spill(slot(i), i);
+            move(0, slot(SP));
+            call(function1);
+            spill(0, SP + 1);
+            unspill(0, SP);
+            call(function2);
+            for(int i = 0; i < SP; ++i) unspill(slot(i), i);
+            unspill(slot(SP), SP + 1);
+            move(slot(SP + 1), 0);
+            ++SP;
+        }
+    };
+
+    void* allocateExecutable(const std::vector<unsigned char>& code)
+    {
+#ifdef FP_JIT_WIN64
+        void* memory = VirtualAlloc(0, code.size(), MEM_COMMIT | MEM_RESERVE,
+                                    PAGE_READWRITE);
+        if(!memory) return 0;
+        std::memcpy(memory, &code[0], code.size());
+        DWORD oldProtection;
+        if(!VirtualProtect(memory, code.size(), PAGE_EXECUTE_READ,
+                           &oldProtection))
+        {
+            VirtualFree(memory, 0, MEM_RELEASE);
+            return 0;
+        }
+        FlushInstructionCache(GetCurrentProcess(), memory, code.size());
+        return memory;
+#else
+        void* memory = mmap(0, code.size(), PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(memory == MAP_FAILED) return 0;
+        std::memcpy(memory, &code[0], code.size());
+        if(mprotect(memory, code.size(), PROT_READ | PROT_EXEC) != 0)
+        {
+            munmap(memory, code.size());
+            return 0;
+        }
+        return memory;
+#endif
+    }
+
+    void freeExecutable(void* memory, std::size_t size)
+    {
+#ifdef FP_JIT_WIN64
+        (void)size;
+        VirtualFree(memory, 0, MEM_RELEASE);
+#else
+        munmap(memory, size);
+#endif
+    }
+}
+#endif // FP_JIT_X86_64
+
+
+//=========================================================================
+// FunctionParserJIT
+//=========================================================================
+FunctionParserJIT::FunctionParserJIT(const FunctionParserBase<double>& parser):
+    mParser(parser),
+    mCode(0),
+    mCodeSize(0),
+    mFunction(0)
+{
+    Compile();
+}
+
+FunctionParserJIT::~FunctionParserJIT()
+{
+#ifdef FP_JIT_X86_64
+    if(mCode) freeExecutable(mCode, mCodeSize);
+#endif
+}
+
+bool FunctionParserJIT::Compile()
+{
+#ifdef FP_JIT_X86_64
+    const FunctionParserBase<double>::Data& data = *mParser.mData;
+    if(data.mParseErrorType != FunctionParserBase<double>::FP_NO_ERROR ||
+       data.mStackSize > MaxStackSize)
+        return false;
+
+    const std::vector<unsigned>& byteCode = data.mByteCode;
+    const unsigned byteCodeSize = unsigned(byteCode.size());
+
+    /* Jump targets are only known as bytecode positions while generating
+       the code, so the displacements are filled in at the end. */
+    std::vector<std::size_t> codeOffsets(byteCodeSize + 1, 0);
+    std::vector<bool> isInstruction(byteCodeSize + 1, false);
+    std::vector<int> targetSP(byteCodeSize + 1, -2);
+    std::vector<std::pair<std::size_t, unsigned> > jumps;
+
+    Assembler code;
+    code.prologue();
+
+    unsigned DP = 0;
+    int SP = -1;
+    bool reachable = true;
+
+    for(unsigned IP = 0; IP < byteCodeSize; ++IP)
+    {
+        if(targetSP[IP] != -2)
+        {
+            if(reachable && targetSP[IP] != SP) return false;
+            SP = targetSP[IP];
+            reachable = true;
+        }
+        if(!reachable) return false;
+
+        codeOffsets[IP] = code.mCode.size();
+        isInstruction[IP] = true;
+
+        const unsigned opcode = byteCode[IP];
+        switch(opcode)
+        {
+          case cAbs:
+              code.loadBits(Temp2, 0x7FFFFFFFFFFFFFFFULL);
+              code.sse(0x66, ANDPD, slot(SP), Temp2);
+              break;
+
+          case cNeg:
+              code.loadBits(Temp2, 0x8000000000000000ULL);
+              code.sse(0x66, XORPD, slot(SP), Temp2);
+              break;
+
+          case cAdd: code.sse(0xF2, ADDSD, slot(SP-1), slot(SP)); --SP; break;
+          case cSub: code.sse(0xF2, SUBSD, slot(SP-1), slot(SP)); --SP; break;
+          case cMul: code.sse(0xF2, MULSD, slot(SP-1), slot(SP)); --SP; break;
+          case cDiv: code.sse(0xF2, DIVSD, slot(SP-1), slot(SP)); --SP; break;
+
+          case cRSub:
+          case cRDiv:
+              code.move(Temp1, slot(SP));
+              code.sse(0xF2, opcode == cRSub ? SUBSD : DIVSD,
+                       Temp1, slot(SP-1));
+              code.move(slot(SP-1), Temp1);
+              --SP; break;
+
+          case cSqr: code.sse(0xF2, MULSD, slot(SP), slot(SP)); break;
+          case cSqrt: code.sse(0xF2, SQRTSD, slot(SP), slot(SP)); break;
+
+          case cInv:
+              code.loadConstant(Temp1, 1.0);
+              code.sse(0xF2, DIVSD, Temp1, slot(SP));
+              code.move(slot(SP), Temp1);
+              break;
+
+          case cRSqrt:
+              code.sse(0xF2, SQRTSD, Temp2, slot(SP));
+              code.loadConstant(Temp1, 1.0);
+              code.sse(0xF2, DIVSD, Temp1, Temp2);
+              code.move(slot(SP), Temp1);
+              break;
+
+          case cDeg:
+          case cRad:
+              code.loadConstant(Temp2, opcode == cDeg ?
+                                fp_const_rad_to_deg<double>() :
+                                fp_const_deg_to_rad<double>());
+              code.sse(0xF2, MULSD, slot(SP), Temp2);
+              break;
+
+          case cImmed:
+              code.loadConstant(slot(SP+1), data.mImmed[DP++]);
+              ++SP; break;
+
+          case cDup: code.move(slot(SP+1), slot(SP)); ++SP; break;
+
+          case cFetch:
+              code.move(slot(SP+1), slot(int(byteCode[++IP])));
+              ++SP; break;
+
+#ifdef FP_SUPPORT_OPTIMIZER
+          case cPopNMov:
+              {
+                  const int target = int(byteCode[++IP]);
+                  const int source = int(byteCode[++IP]);
+                  code.move(slot(target), slot(source));
+                  SP = target;
+                  break;
+              }
+
+          case cNop: break;
+#endif
+
+          case cIf:
+          case cAbsIf:
+              {
+                  // The condition is false if it is below 0.5 or NaN
+                  unsigned condition = slot(SP--);
+                  if(opcode == cIf)
+                  {
+                      code.loadBits(Temp2, 0x7FFFFFFFFFFFFFFFULL);
+                      code.sse(0x66, ANDPD, Temp2, condition);
+                      condition = Temp2;
+                  }
+                  code.loadConstant(Temp1, 0.5);
+                  code.sse(0x66, UCOMISD, condition, Temp1);
+                  const unsigned target = byteCode[IP+1] + 1;
+                  if(target > byteCodeSize) return false;
+                  jumps.push_back(std::make_pair(code.jump(true), target));
+                  targetSP[target] = SP;
+                  IP += 2;
+                  break;
+              }
+
+          case cJump:
+              {
+                  const unsigned target = byteCode[IP+1] + 1;
+                  if(target > byteCodeSize) return false;
+                  jumps.push_back(std::make_pair(code.jump(false), target));
+                  targetSP[target] = SP;
+                  reachable = false;
+                  IP += 2;
+                  break;
+              }
+
+          case cSinCos:
+              code.callFunctionPair((const void*)jitSin, (const void*)jitCos, SP);
+              break;
+
+          case cSinhCosh:
+              code.callFunctionPair((const void*)jitSinh, (const void*)jitCosh, SP);
+              break;
+
+          case cFCall:
+          case cPCall:
+              return false;
+
+          default:
+              if(opcode >= VarBegin)
+              {
+                  code.sseMem(0xF2, MOVSD_LOAD, slot(SP+1), RBX,
+                              8 * (opcode - VarBegin));
+                  ++SP;
+              }
+              else if(UnaryFunction function = unaryFunction(opcode))
+                  code.callFunction((const void*)function, 1, SP);
+              else if(BinaryFunction function = binaryFunction(opcode))
+                  code.callFunction((const void*)function, 2, SP);
+              else
+                  return false;
+        }
+    }
+
+    if(targetSP[byteCodeSize] != -2)
+    {
+        if(reachable && targetSP[byteCodeSize] != SP) return false;
+        SP = targetSP[byteCodeSize];
+    }
+    codeOffsets[byteCodeSize] = code.mCode.size();
+    isInstruction[byteCodeSize] = true;
+    code.move(0, slot(SP));
+    code.epilogue();
+
+    for(std::size_t i = 0; i < jumps.size(); ++i)
+    {
+        const std::size_t position = jumps[i].first;
+        const unsigned target = jumps[i].second;
+        if(!isInstruction[target]) return false;
+        const unsigned displacement =
+            unsigned(codeOffsets[target] - (position + 4));
+        for(unsigned b = 0; b < 4; ++b)
+            code.mCode[position + b] =
+                (unsigned char)((displacement >> (8 * b)) & 0xFF);
+    }
+
+    mCode = allocateExecutable(code.mCode);
+    if(!mCode) return false;
+    mCodeSize = code.mCode.size();
+    mFunction = reinterpret_cast<CompiledFunction>(mCode);
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,57 @@
+/***************************************************************************\
+|* Function Parser for C++ v4.5.2                                          *|
+|*-------------------------------------------------------------------------*|
+|* Native code compiler for FunctionParserBase<double>                     *|
+\***************************************************************************/
+
+#ifndef ONCE_FPARSER_JIT_H_
+#define ONCE_FPARSER_JIT_H_
+
+#include "fparser.hh"
+
+/* Compiles the bytecode of a parsed (and preferably optimized) function to
+   x86-64 machine code. The stack of the bytecode is kept in SSE registers,
+   and mathematical functions are called through the same fp_ functions
+   used by Eval().
+
+   Compilation is not possible when the parser uses user-defined functions
+   (cFCall, cPCall), when the function needs more stack than there are
+   registers, or on other architectures. GetCompiledFunction() then returns
+   0 and Eval() uses the interpreter of the parser instead.
+
+   The compiled code does not report evaluation errors: it follows IEEE 754
+   instead (a division by zero gives an infinity, the log of a negative
+   value gives NaN and so on). It does not use any shared state, so it can
+   be called by any number of threads simultaneously.
+*/
+class FunctionParserJIT
+{
+ public:
+    typedef double (*CompiledFunction)(const double*);
+
+    explicit FunctionParserJIT(const FunctionParserBase<double>& parser);
+    ~FunctionParserJIT();
+
+    CompiledFunction GetCompiledFunction() const { return mFunction; }
+
+    double Eval(const double* Vars)
+    { return mFunction ? mFunction(Vars) : mParser.Eval(Vars); }
+
+    int EvalError() const { return mFunction ? 0 : mParser.EvalError(); }
+
+
+//========================================================================
+ private:
+//========================================================================
+    FunctionParserBase<double> mParser;
+    void* mCode;
+    std::size_t mCodeSize;
+    CompiledFunction mFunction;
+
+    bool Compile();
+
+    FunctionParserJIT(const FunctionParserJIT&); // not implemented on purpose
+    FunctionParserJIT& operator=(const FunctionParserJIT&); // ditto
+};
+
+#endif
@@ -61,6 +61,25 @@
 #define FP_ENABLE_SHORTCUT_LOGICAL_EVALUATION
 #endif
 
+/*
+ Number of evaluations performed side by side by EvalBatch(). Each opcode
+ is applied to a whole block of this many values at a time, which requires
+ a stack of (stack size + 2) * block size + stack size values per parser (or
+ per EvalContext): the columns of the stack, two dummy columns below them,
+ and scratch space for the parameters of the user-defined functions.
+*/
+#ifndef FP_EVAL_BATCH_BLOCK_SIZE
+#define FP_EVAL_BATCH_BLOCK_SIZE 64
+#endif
+
+/*
+ Uncomment this line or define it in your compiler settings to make
+ EvalBatch() use plain loops for the double type instead of the SSE2, AVX2,
+ AVX-512 or NEON kernels selected at runtime. (The results are the same
+ either way; this only helps with compilers lacking the intrinsics.)
+*/
+//#define FP_NO_SIMD_EVAL
+
 /*
  Comment out the following lines out if you are not going to use the
  optimizer and want a slightly smaller library. The Optimize() method
@@ -83,6 +102,10 @@
  function can be made thread-safe at the cost of a possible small overhead.
  The second version requires that the compiler supports the alloca() function,
  which is not standard, but is faster.
+
+ Independently of these settings, the Eval() and EvalBatch() versions taking
+ an EvalContext are const and thread-safe: several threads can evaluate the
+ same parser simultaneously as long as each one uses its own EvalContext.
  */
 //#define FP_USE_THREAD_SAFE_EVAL
 //#define FP_USE_THREAD_SAFE_EVAL_WITH_ALLOCA